@@ -25,235 +25,6023 @@
 #include <Python.h>
 #include <IOKit/IOKitLib.h>
 #include <CoreFoundation/CoreFoundation.h>
+#include <dispatch/dispatch.h>
+#include <os/lock.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
 
 static PyTypeObject LightSensorType;
 static PyTypeObject LightSensorIteratorType;
+static PyTypeObject SampleColumnType;
+static PyTypeObject SampleBatchType;
+static PyTypeObject ResamplerType;
+static PyTypeObject FlickerAnalyzerType;
+static PyTypeObject ChangeDetectorType;
+static PyTypeObject RuleSetType;
+static PyTypeObject BacklightControllerType;
+static PyTypeObject SensorGroupType;
+static PyTypeObject SchedulerType;
+static PyTypeObject ReplaySourceType;
+static PyTypeObject PipelineType;
+static PyTypeObject UplinkType;
+static PyTypeObject SensorDescriptorType;
+static PyTypeObject SensorPoolType;
+
+/* Same clock as time.monotonic_ns(). */
+static int64_t monotonic_ns(void) {
+    return (int64_t)clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+/* For types whose state is set up by __init__: an object made by __new__
+ * alone, or whose __init__ failed, must not be used. */
+static int check_initialized(void* self, int initialized) {
+    if (initialized) return 0;
+    PyErr_Format(PyExc_RuntimeError, "%s object is not initialized.", Py_TYPE((PyObject*)self)->tp_name);
+    return -1;
+}
+
+typedef struct {
+    int64_t* timestamps;
+    double* values;
+    Py_ssize_t length;
+    Py_ssize_t capacity;
+} SampleBuf;
+
+static int SampleBuf_reserve(SampleBuf* buf, Py_ssize_t extra) {
+    if (buf->length + extra <= buf->capacity) return 0;
+
+    Py_ssize_t capacity = buf->capacity ? buf->capacity : 64;
+    while (capacity < buf->length + extra) capacity *= 2;
+
+    int64_t* timestamps = PyMem_RawRealloc(buf->timestamps, capacity * sizeof(int64_t));
+    if (!timestamps) return -1;
+    buf->timestamps = timestamps;
+
+    double* values = PyMem_RawRealloc(buf->values, capacity * sizeof(double));
+    if (!values) return -1;
+    buf->values = values;
+
+    buf->capacity = capacity;
+    return 0;
+}
+
+static int SampleBuf_append(SampleBuf* buf, int64_t timestamp, double value) {
+    if (SampleBuf_reserve(buf, 1) < 0) return -1;
+    buf->timestamps[buf->length] = timestamp;
+    buf->values[buf->length] = value;
+    buf->length++;
+    return 0;
+}
+
+static void SampleBuf_clear(SampleBuf* buf) {
+    PyMem_RawFree(buf->timestamps);
+    PyMem_RawFree(buf->values);
+    memset(buf, 0, sizeof(*buf));
+}
+
+/* A column either owns its data or borrows it from owner, in which case
+ * *pins counts the borrowing columns so the owner can refuse to move it. */
+typedef struct {
+    PyObject_HEAD
+    void* data;
+    Py_ssize_t length;
+    char format[2];
+    Py_ssize_t exports;
+    PyObject* owner;
+    Py_ssize_t* pins;
+} SampleColumnObject;
+
+typedef struct {
+    PyObject_HEAD
+    SampleColumnObject* timestamps;
+    SampleColumnObject* values;
+} SampleBatchObject;
+
+static SampleColumnObject* SampleColumn_new(void* data, Py_ssize_t length, char format) {
+    SampleColumnObject* column = PyObject_New(SampleColumnObject, &SampleColumnType);
+    if (!column) {
+        PyMem_RawFree(data);
+        return NULL;
+    }
+
+    column->data = data;
+    column->length = length;
+    column->format[0] = format;
+    column->format[1] = '\0';
+    column->exports = 0;
+    column->owner = NULL;
+    column->pins = NULL;
+    return column;
+}
+
+static SampleColumnObject* SampleColumn_borrow(PyObject* owner, Py_ssize_t* pins, void* data, Py_ssize_t length, char format) {
+    SampleColumnObject* column = PyObject_New(SampleColumnObject, &SampleColumnType);
+    if (!column) return NULL;
+
+    column->data = data;
+    column->length = length;
+    column->format[0] = format;
+    column->format[1] = '\0';
+    column->exports = 0;
+    Py_INCREF(owner);
+    column->owner = owner;
+    column->pins = pins;
+    (*pins)++;
+    return column;
+}
+
+static void SampleColumn_dealloc(SampleColumnObject* self) {
+    if (self->owner) {
+        (*self->pins)--;
+        Py_DECREF(self->owner);
+    } else {
+        PyMem_RawFree(self->data);
+    }
+    PyObject_Free(self);
+}
+
+static Py_ssize_t SampleColumn_length(SampleColumnObject* self) {
+    return self->length;
+}
+
+static PyObject* SampleColumn_item(SampleColumnObject* self, Py_ssize_t i) {
+    if (i < 0 || i >= self->length) {
+        PyErr_SetString(PyExc_IndexError, "column index out of range");
+        return NULL;
+    }
+    if (self->format[0] == 'q') {
+        return PyLong_FromLongLong(((int64_t*)self->data)[i]);
+    }
+    return PyFloat_FromDouble(((double*)self->data)[i]);
+}
+
+static int SampleColumn_getbuffer(SampleColumnObject* self, Py_buffer* view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "SampleColumn is read-only.");
+        view->obj = NULL;
+        return -1;
+    }
+
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->buf = self->data;
+    view->itemsize = self->format[0] == 'q' ? sizeof(int64_t) : sizeof(double);
+    view->len = self->length * view->itemsize;
+    view->readonly = 1;
+    view->ndim = 1;
+    view->format = (flags & PyBUF_FORMAT) ? self->format : NULL;
+    view->shape = (flags & PyBUF_ND) ? &self->length : NULL;
+    view->strides = (flags & PyBUF_STRIDES) ? &view->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    self->exports++;
+    return 0;
+}
+
+static void SampleColumn_releasebuffer(SampleColumnObject* self, Py_buffer* view) {
+    self->exports--;
+}
+
+static PySequenceMethods SampleColumn_as_sequence = {
+    .sq_length = (lenfunc)SampleColumn_length,
+    .sq_item = (ssizeargfunc)SampleColumn_item,
+};
+
+static PyBufferProcs SampleColumn_as_buffer = {
+    .bf_getbuffer = (getbufferproc)SampleColumn_getbuffer,
+    .bf_releasebuffer = (releasebufferproc)SampleColumn_releasebuffer,
+};
+
+/* DLPack (https://dmlc.github.io/dlpack/latest/) and Arrow C Data Interface
+ * (https://arrow.apache.org/docs/format/CDataInterface.html) definitions,
+ * copied from the specifications since neither ships a system header. */
+typedef struct {
+    int32_t device_type;
+    int32_t device_id;
+} DLDevice;
+
+typedef struct {
+    uint8_t code;
+    uint8_t bits;
+    uint16_t lanes;
+} DLDataType;
+
+typedef struct {
+    void* data;
+    DLDevice device;
+    int32_t ndim;
+    DLDataType dtype;
+    int64_t* shape;
+    int64_t* strides;
+    uint64_t byte_offset;
+} DLTensor;
+
+typedef struct {
+    uint32_t major;
+    uint32_t minor;
+} DLPackVersion;
+
+typedef struct DLManagedTensorVersioned {
+    DLPackVersion version;
+    void* manager_ctx;
+    void (*deleter)(struct DLManagedTensorVersioned* self);
+    uint64_t flags;
+    DLTensor dl_tensor;
+} DLManagedTensorVersioned;
+
+#define DL_CPU 1
+#define DL_INT 0
+#define DL_FLOAT 2
+#define DLPACK_FLAG_READ_ONLY (1ULL << 0)
+#define ARROW_FLAG_NULLABLE 2
+
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+/* Both exports keep the exporting object alive until the consumer calls the
+ * deleter or release callback, which may happen on any thread. */
+typedef struct {
+    DLManagedTensorVersioned versioned;
+    int64_t shape;
+    PyObject* owner;
+} DLPackExport;
+
+static void DLPackExport_free(DLPackExport* ctx) {
+    PyGILState_STATE gil = PyGILState_Ensure();
+    Py_DECREF(ctx->owner);
+    PyGILState_Release(gil);
+    PyMem_RawFree(ctx);
+}
+
+static void DLPackExport_deleter_versioned(DLManagedTensorVersioned* tensor) {
+    DLPackExport_free((DLPackExport*)tensor->manager_ctx);
+}
+
+static void dlpack_capsule_destructor(PyObject* capsule) {
+    if (PyCapsule_IsValid(capsule, "dltensor_versioned")) {
+        DLManagedTensorVersioned* tensor = PyCapsule_GetPointer(capsule, "dltensor_versioned");
+        tensor->deleter(tensor);
+    }
+}
+
+static PyObject* SampleColumn_dlpack(SampleColumnObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"stream", "max_version", "dl_device", "copy", NULL};
+    PyObject *stream = Py_None, *max_version = Py_None, *dl_device = Py_None, *copy = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$OOOO", kwlist, &stream, &max_version, &dl_device, &copy)) {
+        return NULL;
+    }
+    if (stream != Py_None) {
+        PyErr_SetString(PyExc_ValueError, "stream must be None for CPU data.");
+        return NULL;
+    }
+    if (copy == Py_True) {
+        PyErr_SetString(PyExc_BufferError, "SampleColumn only exports without copying.");
+        return NULL;
+    }
+    if (dl_device != Py_None) {
+        int device_type, device_id;
+        if (!PyArg_ParseTuple(dl_device, "ii", &device_type, &device_id)) return NULL;
+        if (device_type != DL_CPU || device_id != 0) {
+            PyErr_SetString(PyExc_BufferError, "SampleColumn is only available on the CPU.");
+            return NULL;
+        }
+    }
+
+    /* Only versioned tensors can carry the read-only flag; a legacy
+     * consumer would be free to write into the ring. */
+    long major = 0, minor = 0;
+    if (max_version != Py_None && !PyArg_ParseTuple(max_version, "ll", &major, &minor)) return NULL;
+    if (major < 1) {
+        PyErr_SetString(PyExc_BufferError, "SampleColumn is read-only and needs a DLPack 1.0 consumer (max_version >= (1, 0)).");
+        return NULL;
+    }
+
+    DLPackExport* ctx = PyMem_RawCalloc(1, sizeof(DLPackExport));
+    if (!ctx) return PyErr_NoMemory();
+
+    Py_INCREF(self);
+    ctx->owner = (PyObject*)self;
+    ctx->shape = self->length;
+
+    DLTensor tensor = {
+        .data = self->data,
+        .device = {DL_CPU, 0},
+        .ndim = 1,
+        .dtype = {self->format[0] == 'q' ? DL_INT : DL_FLOAT, 64, 1},
+        .shape = &ctx->shape,
+        .strides = NULL,
+        .byte_offset = 0,
+    };
+
+    ctx->versioned = (DLManagedTensorVersioned){{1, 0}, ctx, DLPackExport_deleter_versioned, DLPACK_FLAG_READ_ONLY, tensor};
+    PyObject* capsule = PyCapsule_New(&ctx->versioned, "dltensor_versioned", dlpack_capsule_destructor);
+    if (!capsule) DLPackExport_free(ctx);
+    return capsule;
+}
+
+static PyObject* SampleColumn_dlpack_device(SampleColumnObject* self, PyObject* Py_UNUSED(ignored)) {
+    return Py_BuildValue("(ii)", DL_CPU, 0);
+}
+
+static void arrow_schema_release(struct ArrowSchema* schema) {
+    for (int64_t i = 0; i < schema->n_children; i++) {
+        if (schema->children[i]->release) schema->children[i]->release(schema->children[i]);
+        PyMem_RawFree(schema->children[i]);
+    }
+    PyMem_RawFree(schema->children);
+    schema->release = NULL;
+}
+
+static void arrow_array_release(struct ArrowArray* array) {
+    for (int64_t i = 0; i < array->n_children; i++) {
+        if (array->children[i]->release) array->children[i]->release(array->children[i]);
+        PyMem_RawFree(array->children[i]);
+    }
+    PyMem_RawFree(array->children);
+    PyMem_RawFree(array->buffers);
+    if (array->private_data) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        Py_DECREF((PyObject*)array->private_data);
+        PyGILState_Release(gil);
+    }
+    array->release = NULL;
+}
+
+static void arrow_schema_capsule_destructor(PyObject* capsule) {
+    struct ArrowSchema* schema = PyCapsule_GetPointer(capsule, "arrow_schema");
+    if (schema->release) schema->release(schema);
+    PyMem_RawFree(schema);
+}
+
+static void arrow_array_capsule_destructor(PyObject* capsule) {
+    struct ArrowArray* array = PyCapsule_GetPointer(capsule, "arrow_array");
+    if (array->release) array->release(array);
+    PyMem_RawFree(array);
+}
+
+/* A requested_schema may only ask for the native layout of a column, except
+ * that int64 columns can also be read as timestamp[ns] or duration[ns].
+ * Returns the format to export, or NULL with ValueError. */
+static const char* arrow_column_format(const SampleColumnObject* column, const struct ArrowSchema* requested) {
+    static const char* int64_formats[] = {"l", "tsn:", "tDn", NULL};
+    static const char* float64_formats[] = {"g", NULL};
+    const char** formats = column->format[0] == 'q' ? int64_formats : float64_formats;
+    if (!requested) return formats[0];
+    for (int i = 0; formats[i]; i++) {
+        if (strcmp(requested->format, formats[i]) == 0) return formats[i];
+    }
+    PyErr_Format(PyExc_ValueError, "Cannot export a %s column as Arrow format '%s' without copying.",
+                 column->format[0] == 'q' ? "int64" : "float64", requested->format);
+    return NULL;
+}
+
+/* NULL with no exception set when requested_schema is None. */
+static struct ArrowSchema* arrow_requested_schema(PyObject* requested_schema) {
+    if (requested_schema == Py_None) return NULL;
+    return PyCapsule_GetPointer(requested_schema, "arrow_schema");
+}
+
+static int SampleColumn_fill_arrow(SampleColumnObject* self, const char* name, const char* format, int64_t flags, struct ArrowSchema* schema, struct ArrowArray* array) {
+    const void** buffers = PyMem_RawMalloc(2 * sizeof(void*));
+    if (!buffers) return -1;
+    buffers[0] = NULL;
+    buffers[1] = self->data;
+
+    *schema = (struct ArrowSchema){
+        .format = format,
+        .name = name,
+        .flags = flags,
+        .release = arrow_schema_release,
+    };
+
+    Py_INCREF(self);
+    *array = (struct ArrowArray){
+        .length = self->length,
+        .n_buffers = 2,
+        .buffers = buffers,
+        .release = arrow_array_release,
+        .private_data = self,
+    };
+    return 0;
+}
+
+static PyObject* arrow_capsules(struct ArrowSchema* schema, struct ArrowArray* array) {
+    PyObject* schema_capsule = PyCapsule_New(schema, "arrow_schema", arrow_schema_capsule_destructor);
+    if (!schema_capsule) {
+        schema->release(schema);
+        PyMem_RawFree(schema);
+        array->release(array);
+        PyMem_RawFree(array);
+        return NULL;
+    }
+
+    PyObject* array_capsule = PyCapsule_New(array, "arrow_array", arrow_array_capsule_destructor);
+    if (!array_capsule) {
+        Py_DECREF(schema_capsule);
+        array->release(array);
+        PyMem_RawFree(array);
+        return NULL;
+    }
+
+    PyObject* result = PyTuple_Pack(2, schema_capsule, array_capsule);
+    Py_DECREF(schema_capsule);
+    Py_DECREF(array_capsule);
+    return result;
+}
+
+static PyObject* SampleColumn_arrow_c_array(SampleColumnObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"requested_schema", NULL};
+    PyObject* requested_schema = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &requested_schema)) return NULL;
+
+    struct ArrowSchema* requested = arrow_requested_schema(requested_schema);
+    if (!requested && PyErr_Occurred()) return NULL;
+    const char* format = arrow_column_format(self, requested);
+    if (!format) return NULL;
+
+    struct ArrowSchema* schema = PyMem_RawMalloc(sizeof(*schema));
+    struct ArrowArray* array = PyMem_RawMalloc(sizeof(*array));
+    if (!schema || !array || SampleColumn_fill_arrow(self, "", format, 0, schema, array) < 0) {
+        PyMem_RawFree(schema);
+        PyMem_RawFree(array);
+        return PyErr_NoMemory();
+    }
+    return arrow_capsules(schema, array);
+}
+
+static PyMethodDef SampleColumn_methods[] = {
+    {"__dlpack__", (PyCFunction)(void(*)(void))SampleColumn_dlpack, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Export the column as a read-only DLPack tensor without copying.")},
+    {"__dlpack_device__", (PyCFunction)SampleColumn_dlpack_device, METH_NOARGS, PyDoc_STR("Return the DLPack device of the column (always the CPU).")},
+    {"__arrow_c_array__", (PyCFunction)(void(*)(void))SampleColumn_arrow_c_array, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Export the column as an Arrow array without copying.")},
+    {NULL}
+};
+
+static PyTypeObject SampleColumnType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.SampleColumn",
+    .tp_basicsize = sizeof(SampleColumnObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Read-only column of a SampleBatch, exported through the buffer protocol, DLPack and Arrow",
+    .tp_as_sequence = &SampleColumn_as_sequence,
+    .tp_as_buffer = &SampleColumn_as_buffer,
+    .tp_methods = SampleColumn_methods,
+    .tp_dealloc = (destructor)SampleColumn_dealloc,
+};
+
+/* Steals both column references. */
+static PyObject* SampleBatch_from_columns(SampleColumnObject* ts_column, SampleColumnObject* value_column) {
+    SampleBatchObject* batch = PyObject_New(SampleBatchObject, &SampleBatchType);
+    if (!batch) {
+        Py_DECREF(ts_column);
+        Py_DECREF(value_column);
+        return NULL;
+    }
+
+    batch->timestamps = ts_column;
+    batch->values = value_column;
+    return (PyObject*)batch;
+}
+
+/* Hands the storage of buf over to a new SampleBatch and leaves buf empty. */
+static PyObject* SampleBatch_from_buf(SampleBuf* buf) {
+    Py_ssize_t length = buf->length;
+    int64_t* timestamps = buf->timestamps;
+    double* values = buf->values;
+    memset(buf, 0, sizeof(*buf));
+
+    SampleColumnObject* ts_column = SampleColumn_new(timestamps, length, 'q');
+    if (!ts_column) {
+        PyMem_RawFree(values);
+        return NULL;
+    }
+
+    SampleColumnObject* value_column = SampleColumn_new(values, length, 'd');
+    if (!value_column) {
+        Py_DECREF(ts_column);
+        return NULL;
+    }
+
+    return SampleBatch_from_columns(ts_column, value_column);
+}
+
+static void SampleBatch_dealloc(SampleBatchObject* self) {
+    Py_XDECREF(self->timestamps);
+    Py_XDECREF(self->values);
+    PyObject_Free(self);
+}
+
+static Py_ssize_t SampleBatch_length(SampleBatchObject* self) {
+    return self->values->length;
+}
+
+static PyObject* SampleBatch_item(SampleBatchObject* self, Py_ssize_t i) {
+    if (i < 0 || i >= self->values->length) {
+        PyErr_SetString(PyExc_IndexError, "batch index out of range");
+        return NULL;
+    }
+    return Py_BuildValue("(Ld)", (long long)((int64_t*)self->timestamps->data)[i], ((double*)self->values->data)[i]);
+}
+
+static PyObject* SampleBatch_repr(SampleBatchObject* self) {
+    return PyUnicode_FromFormat("<SampleBatch of %zd samples>", self->values->length);
+}
+
+static PyObject* SampleBatch_get_timestamps(SampleBatchObject* self, void* closure) {
+    Py_INCREF(self->timestamps);
+    return (PyObject*)self->timestamps;
+}
+
+static PyObject* SampleBatch_get_values(SampleBatchObject* self, void* closure) {
+    Py_INCREF(self->values);
+    return (PyObject*)self->values;
+}
+
+static PyGetSetDef SampleBatch_getset[] = {
+    {"timestamps", (getter)SampleBatch_get_timestamps, NULL, "sample timestamps in nanoseconds (int64 column)", NULL},
+    {"values", (getter)SampleBatch_get_values, NULL, "sample values in lux (float64 column)", NULL},
+    {NULL}
+};
+
+static PySequenceMethods SampleBatch_as_sequence = {
+    .sq_length = (lenfunc)SampleBatch_length,
+    .sq_item = (ssizeargfunc)SampleBatch_item,
+};
+
+static PyObject* SampleBatch_arrow_c_array(SampleBatchObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"requested_schema", NULL};
+    PyObject* requested_schema = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &requested_schema)) return NULL;
+
+    static const char* names[] = {"timestamp_ns", "lux"};
+    SampleColumnObject* columns[] = {self->timestamps, self->values};
+    const char* formats[2];
+    int64_t flags[2] = {0, 0};
+    struct ArrowSchema* requested = arrow_requested_schema(requested_schema);
+    if (!requested && PyErr_Occurred()) return NULL;
+    if (requested && (strcmp(requested->format, "+s") != 0 || requested->n_children != 2)) {
+        PyErr_Format(PyExc_ValueError, "Cannot export a SampleBatch as Arrow format '%s'; it is a struct of timestamp_ns and lux.", requested->format);
+        return NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        const struct ArrowSchema* child = requested ? requested->children[i] : NULL;
+        if (child && child->name && strcmp(child->name, names[i]) != 0) {
+            PyErr_Format(PyExc_ValueError, "Field %d of the requested schema must be named '%s'.", i, names[i]);
+            return NULL;
+        }
+        if (!(formats[i] = arrow_column_format(columns[i], child))) return NULL;
+        if (child) flags[i] = child->flags & ARROW_FLAG_NULLABLE;
+    }
+
+    struct ArrowSchema* schema = PyMem_RawCalloc(1, sizeof(*schema));
+    struct ArrowArray* array = PyMem_RawCalloc(1, sizeof(*array));
+    struct ArrowSchema** schema_children = PyMem_RawCalloc(2, sizeof(*schema_children));
+    struct ArrowArray** array_children = PyMem_RawCalloc(2, sizeof(*array_children));
+    const void** buffers = PyMem_RawCalloc(1, sizeof(*buffers));
+    int ok = schema && array && schema_children && array_children && buffers;
+    for (int i = 0; ok && i < 2; i++) {
+        schema_children[i] = PyMem_RawCalloc(1, sizeof(struct ArrowSchema));
+        array_children[i] = PyMem_RawCalloc(1, sizeof(struct ArrowArray));
+        ok = schema_children[i] && array_children[i];
+    }
+    if (ok) ok = SampleColumn_fill_arrow(columns[0], names[0], formats[0], flags[0], schema_children[0], array_children[0]) == 0;
+    if (ok && SampleColumn_fill_arrow(columns[1], names[1], formats[1], flags[1], schema_children[1], array_children[1]) < 0) {
+        array_children[0]->release(array_children[0]);
+        ok = 0;
+    }
+    if (!ok) {
+        for (int i = 0; i < 2; i++) {
+            if (schema_children) PyMem_RawFree(schema_children[i]);
+            if (array_children) PyMem_RawFree(array_children[i]);
+        }
+        PyMem_RawFree(schema_children);
+        PyMem_RawFree(array_children);
+        PyMem_RawFree(buffers);
+        PyMem_RawFree(schema);
+        PyMem_RawFree(array);
+        return PyErr_NoMemory();
+    }
+
+    *schema = (struct ArrowSchema){
+        .format = "+s",
+        .name = "",
+        .n_children = 2,
+        .children = schema_children,
+        .release = arrow_schema_release,
+    };
+    *array = (struct ArrowArray){
+        .length = self->values->length,
+        .n_buffers = 1,
+        .n_children = 2,
+        .buffers = buffers,
+        .children = array_children,
+        .release = arrow_array_release,
+    };
+    return arrow_capsules(schema, array);
+}
+
+static PyMethodDef SampleBatch_methods[] = {
+    {"__arrow_c_array__", (PyCFunction)(void(*)(void))SampleBatch_arrow_c_array, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Export the batch as an Arrow struct array (timestamp_ns, lux) without copying.")},
+    {NULL}
+};
+
+static PyTypeObject SampleBatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.SampleBatch",
+    .tp_basicsize = sizeof(SampleBatchObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Batch of (timestamp_ns, lux) samples stored as two native columns",
+    .tp_as_sequence = &SampleBatch_as_sequence,
+    .tp_methods = SampleBatch_methods,
+    .tp_getset = SampleBatch_getset,
+    .tp_dealloc = (destructor)SampleBatch_dealloc,
+    .tp_repr = (reprfunc)SampleBatch_repr,
+};
+
+typedef enum {
+    RING_FLOAT64,
+    RING_FLOAT32,
+    RING_FLOAT16,
+    RING_UINT16,
+} RingFormat;
+
+static const char* ring_format_names[] = {"float64", "float32", "float16", "uint16", NULL};
+
+/* Compact formats keep timestamps as uint32 deltas from a per-block base,
+ * shifted right by the block's shift once the block spans more than 2^32 ns,
+ * and uint16 values as the block's offset plus codes times its scale. The
+ * uint16 grid is kept centred on the block's smallest and largest readings
+ * (low, high), and the top code stands for nan. */
+#define RING_BLOCK 256
+#define RING_UINT16_NAN 65535
+#define RING_UINT16_MAX 65534
+
+typedef struct {
+    int64_t base;
+    double offset;
+    double scale;
+    double low;
+    double high;
+    int shift;
+} RingBlock;
+
+/* Fixed-capacity ring of recorded samples. head and tail count samples ever
+ * written and ever drained, so the slot of sample i is i % slots and the
+ * retained history is [head - capacity, head). When the ring is full the
+ * oldest undrained sample is dropped, unless it is part of the region handed
+ * out by acquire(), in which case the new sample is dropped instead. views
+ * counts the columns borrowing the ring's memory.
+ *
+ * float64 rings store plain timestamp and value columns with slots equal to
+ * capacity. The compact formats store RING_BLOCK-sample blocks and keep one
+ * spare block, so starting a block never overwrites a retained sample. */
+typedef struct {
+    RingFormat format;
+    int64_t* timestamps;
+    double* values;
+    uint32_t* deltas;
+    void* codes;
+    RingBlock* blocks;
+    Py_ssize_t capacity;
+    Py_ssize_t slots;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+    Py_ssize_t leased;
+    Py_ssize_t views;
+} SampleRing;
+
+static void SampleRing_clear(SampleRing* ring) {
+    Py_ssize_t views = ring->views;
+    PyMem_RawFree(ring->timestamps);
+    PyMem_RawFree(ring->values);
+    PyMem_RawFree(ring->deltas);
+    PyMem_RawFree(ring->codes);
+    PyMem_RawFree(ring->blocks);
+    memset(ring, 0, sizeof(*ring));
+    ring->views = views;
+}
+
+static int SampleRing_init(SampleRing* ring, Py_ssize_t capacity, RingFormat format) {
+    SampleRing_clear(ring);
+    ring->format = format;
+    if (capacity == 0) return 0;
+
+    int ok;
+    if (format == RING_FLOAT64) {
+        ring->slots = capacity;
+        ring->timestamps = PyMem_RawMalloc(capacity * sizeof(int64_t));
+        ring->values = PyMem_RawMalloc(capacity * sizeof(double));
+        ok = ring->timestamps && ring->values;
+    } else {
+        ring->slots = (capacity + RING_BLOCK - 1) / RING_BLOCK * RING_BLOCK + RING_BLOCK;
+        ring->deltas = PyMem_RawMalloc(ring->slots * sizeof(uint32_t));
+        ring->codes = PyMem_RawMalloc(ring->slots * (format == RING_FLOAT32 ? sizeof(float) : sizeof(uint16_t)));
+        ring->blocks = PyMem_RawCalloc(ring->slots / RING_BLOCK, sizeof(RingBlock));
+        ok = ring->deltas && ring->codes && ring->blocks;
+    }
+    if (!ok) {
+        SampleRing_clear(ring);
+        return -1;
+    }
+    ring->capacity = capacity;
+    return 0;
+}
+
+/* IEEE binary16 conversions, rounding to nearest even. Values beyond the
+ * half range saturate at 65504 rather than becoming infinite. */
+static uint16_t float_to_half(float value) {
+    union { float f; uint32_t u; } v = {value};
+    uint32_t sign = (v.u >> 16) & 0x8000;
+    v.u &= 0x7fffffff;
+
+    if (v.u > 0x7f800000) return sign | 0x7e00;
+    if (v.u >= 0x477ff000) return sign | 0x7bff;
+    if (v.u < 0x38800000) {
+        union { float f; uint32_t u; } magic = {.u = 126 << 23};
+        v.f += magic.f;
+        return sign | (uint16_t)(v.u - magic.u);
+    }
+    uint32_t odd = (v.u >> 13) & 1;
+    v.u += 0xc8000fff + odd;
+    return sign | (uint16_t)(v.u >> 13);
+}
+
+static double half_to_double(uint16_t h) {
+    union { float f; uint32_t u; } v = {.u = (uint32_t)(h & 0x7fff) << 13};
+    uint32_t exponent = v.u & 0x0f800000;
+    v.u += 112u << 23;
+    if (exponent == 0x0f800000) {
+        v.u += 112u << 23;
+    } else if (exponent == 0) {
+        union { float f; uint32_t u; } magic = {.u = 113u << 23};
+        v.u += 1u << 23;
+        v.f -= magic.f;
+    }
+    v.u |= (uint32_t)(h & 0x8000) << 16;
+    return v.f;
+}
+
+static uint16_t ring_scale_code(double value, double offset, double scale) {
+    if (isnan(value)) return RING_UINT16_NAN;
+    if (scale == 0) return 0;
+    double code = round((value - offset) / scale);
+    if (code < 0) return 0;
+    return code > RING_UINT16_MAX ? RING_UINT16_MAX : (uint16_t)code;
+}
+
+/* Fits a finite value into a uint16 block. A value outside the grid at least
+ * doubles the scale, so recoding costs amortised O(1) per sample and the
+ * rounding errors of all recodings add up to less than the final scale.
+ * Centring the grid keeps its range within 4x the spread of the readings. */
+static void ring_scale_fit(RingBlock* block, uint16_t* codes, Py_ssize_t count, double value) {
+    if (isnan(block->low)) {
+        block->offset = block->low = block->high = value;
+        block->scale = 0;
+        return;
+    }
+    if (value < block->low) block->low = value;
+    if (value > block->high) block->high = value;
+    double range = block->scale * RING_UINT16_MAX;
+    if (value >= block->offset && value <= block->offset + range) return;
+
+    double spread = block->high - block->low;
+    double wider = range * 2 > spread ? range * 2 : spread;
+    double offset = (block->low + block->high - wider) / 2;
+    double scale = wider / RING_UINT16_MAX;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (codes[i] != RING_UINT16_NAN) codes[i] = ring_scale_code(block->offset + codes[i] * block->scale, offset, scale);
+    }
+    block->offset = offset;
+    block->scale = scale;
+}
+
+/* Stores a sample in a compact ring slot. The first sample of a block sets
+ * its base and scale; later ones widen the shift or scale as needed and
+ * recode the samples already in the block. */
+static void SampleRing_encode(SampleRing* ring, Py_ssize_t slot, int64_t timestamp, double value) {
+    RingBlock* block = &ring->blocks[slot / RING_BLOCK];
+    Py_ssize_t start = slot - slot % RING_BLOCK;
+
+    if (slot == start) {
+        block->base = timestamp;
+        block->shift = 0;
+        block->offset = block->low = block->high = NAN;
+        block->scale = 0;
+    }
+
+    uint64_t delta = timestamp > block->base ? (uint64_t)(timestamp - block->base) : 0;
+    int shift = block->shift;
+    while ((delta >> shift) > UINT32_MAX) shift++;
+    if (shift != block->shift) {
+        for (Py_ssize_t i = start; i < slot; i++) ring->deltas[i] >>= shift - block->shift;
+        block->shift = shift;
+    }
+    ring->deltas[slot] = (uint32_t)(delta >> shift);
+
+    switch (ring->format) {
+    case RING_FLOAT32:
+        ((float*)ring->codes)[slot] = (float)value;
+        break;
+    case RING_FLOAT16:
+        ((uint16_t*)ring->codes)[slot] = float_to_half((float)value);
+        break;
+    case RING_UINT16: {
+        uint16_t* codes = ring->codes;
+        if (!isfinite(value)) value = NAN;
+        else ring_scale_fit(block, codes + start, slot - start, value);
+        codes[slot] = ring_scale_code(value, block->offset, block->scale);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* Decodes count samples starting at slot, which must not cross a block. */
+static void SampleRing_decode(const SampleRing* ring, Py_ssize_t slot, Py_ssize_t count, int64_t* timestamps, double* values) {
+    const RingBlock* block = &ring->blocks[slot / RING_BLOCK];
+    const uint32_t* deltas = ring->deltas + slot;
+    int64_t base = block->base;
+    int shift = block->shift;
+    for (Py_ssize_t i = 0; i < count; i++) timestamps[i] = base + ((int64_t)deltas[i] << shift);
+
+    if (ring->format == RING_FLOAT32) {
+        const float* codes = (const float*)ring->codes + slot;
+        for (Py_ssize_t i = 0; i < count; i++) values[i] = codes[i];
+    } else if (ring->format == RING_FLOAT16) {
+        const uint16_t* codes = (const uint16_t*)ring->codes + slot;
+        for (Py_ssize_t i = 0; i < count; i++) values[i] = half_to_double(codes[i]);
+    } else {
+        const uint16_t* codes = (const uint16_t*)ring->codes + slot;
+        double offset = block->offset, scale = block->scale;
+        for (Py_ssize_t i = 0; i < count; i++) values[i] = codes[i] == RING_UINT16_NAN ? NAN : offset + codes[i] * scale;
+    }
+}
+
+static int64_t SampleRing_timestamp(const SampleRing* ring, Py_ssize_t slot) {
+    if (ring->format == RING_FLOAT64) return ring->timestamps[slot];
+    const RingBlock* block = &ring->blocks[slot / RING_BLOCK];
+    return block->base + ((int64_t)ring->deltas[slot] << block->shift);
+}
+
+static void SampleRing_push(SampleRing* ring, int64_t timestamp, double value) {
+    if (!ring->capacity) return;
+
+    if (ring->head - ring->tail == (uint64_t)ring->capacity) {
+        ring->dropped++;
+        if (ring->leased) return;
+        ring->tail++;
+    }
+
+    Py_ssize_t slot = ring->head % ring->slots;
+    if (ring->format == RING_FLOAT64) {
+        ring->timestamps[slot] = timestamp;
+        ring->values[slot] = value;
+    } else {
+        SampleRing_encode(ring, slot, timestamp, value);
+    }
+    ring->head++;
+}
+
+/* Copies samples [start, start + count) into out. */
+static int SampleRing_copy(const SampleRing* ring, uint64_t start, Py_ssize_t count, SampleBuf* out) {
+    if (SampleBuf_reserve(out, count) < 0) return -1;
+
+    Py_ssize_t slot = start % ring->slots;
+    if (ring->format == RING_FLOAT64) {
+        Py_ssize_t first = count < ring->slots - slot ? count : ring->slots - slot;
+        memcpy(out->timestamps + out->length, ring->timestamps + slot, first * sizeof(int64_t));
+        memcpy(out->values + out->length, ring->values + slot, first * sizeof(double));
+        memcpy(out->timestamps + out->length + first, ring->timestamps, (count - first) * sizeof(int64_t));
+        memcpy(out->values + out->length + first, ring->values, (count - first) * sizeof(double));
+        out->length += count;
+        return 0;
+    }
+
+    while (count > 0) {
+        Py_ssize_t run = RING_BLOCK - slot % RING_BLOCK;
+        if (run > count) run = count;
+        SampleRing_decode(ring, slot, run, out->timestamps + out->length, out->values + out->length);
+        out->length += run;
+        count -= run;
+        slot = (slot + run) % ring->slots;
+    }
+    return 0;
+}
+
+/* First sample in [lo, hi) with a timestamp >= t; timestamps never decrease. */
+static uint64_t SampleRing_bisect(const SampleRing* ring, uint64_t lo, uint64_t hi, int64_t t) {
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (SampleRing_timestamp(ring, mid % ring->slots) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Copies the retained samples with since <= timestamp < until into out. */
+static int SampleRing_history(const SampleRing* ring, int64_t since, int64_t until, SampleBuf* out) {
+    if (!ring->capacity || since >= until) return 0;
+
+    uint64_t oldest = ring->head > (uint64_t)ring->capacity ? ring->head - ring->capacity : 0;
+    uint64_t start = SampleRing_bisect(ring, oldest, ring->head, since);
+    uint64_t end = SampleRing_bisect(ring, start, ring->head, until);
+    return end > start ? SampleRing_copy(ring, start, (Py_ssize_t)(end - start), out) : 0;
+}
+
+static int SampleRing_drain(SampleRing* ring, Py_ssize_t max_samples, SampleBuf* out) {
+    Py_ssize_t count = (Py_ssize_t)(ring->head - ring->tail);
+    if (max_samples >= 0 && max_samples < count) count = max_samples;
+    if (count && SampleRing_copy(ring, ring->tail, count, out) < 0) return -1;
+    ring->tail += count;
+    return 0;
+}
+
+typedef struct {
+    PyObject_HEAD
+    io_service_t service;
+    char service_name[128];
+    SampleRing ring;
+    os_unfair_lock ring_lock;
+    pthread_mutex_t read_lock;
+    pthread_cond_t read_done;
+    int reading;
+    uint64_t read_generation;
+    float shared_lux;
+    int shared_status;
+    int64_t shared_timestamp;
+} LightSensorObject;
+
+typedef struct {
+    io_service_t service;
+    int is_sensor;
+    char name[128];
+} DiscoveryCandidate;
+
+typedef struct {
+    PyObject_HEAD
+    io_iterator_t iter;
+    DiscoveryCandidate* batch;
+    Py_ssize_t batch_size;
+    Py_ssize_t batch_len;
+    Py_ssize_t batch_pos;
+    int filling;
+} LightSensorIterator;
+
+static void LightSensor_dealloc(LightSensorObject* self) {
+    if (self->service != MACH_PORT_NULL) {
+        IOObjectRelease(self->service);
+        self->service = MACH_PORT_NULL;
+    }
+    SampleRing_clear(&self->ring);
+    pthread_cond_destroy(&self->read_done);
+    pthread_mutex_destroy(&self->read_lock);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* LightSensor_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+    LightSensorObject* self = (LightSensorObject*)type->tp_alloc(type, 0);
+    if (!self) return NULL;
+    pthread_mutex_init(&self->read_lock, NULL);
+    pthread_cond_init(&self->read_done, NULL);
+    return (PyObject*)self;
+}
+
+typedef enum {
+    LUX_OK,
+    LUX_NO_SERVICE,
+    LUX_NO_PROPERTY,
+    LUX_NOT_A_NUMBER,
+} LuxStatus;
+
+static const char* lux_status_messages[] = {
+    NULL,
+    "No valid sensor service.",
+    "Failed to get CurrentLux property.",
+    "CurrentLux is not a number.",
+};
+
+/* Does not touch Python state, so it may run without the GIL. */
+static LuxStatus read_current_lux(io_service_t service, float* lux) {
+    if (!service) return LUX_NO_SERVICE;
+
+    CFTypeRef luxValue = IORegistryEntryCreateCFProperty(service, CFSTR("CurrentLux"), kCFAllocatorDefault, 0);
+    if (!luxValue) return LUX_NO_PROPERTY;
+
+    LuxStatus status = LUX_OK;
+    if (CFGetTypeID(luxValue) == CFNumberGetTypeID()) {
+        CFNumberGetValue((CFNumberRef)luxValue, kCFNumberFloatType, lux);
+    } else {
+        status = LUX_NOT_A_NUMBER;
+    }
+
+    CFRelease(luxValue);
+    return status;
+}
+
+/* Single-flight read: a caller arriving while another read of the same sensor
+ * is in flight waits for it and shares its result instead of querying the
+ * registry again, so only the leader records the sample. Does not touch
+ * Python state. */
+static LuxStatus LightSensor_read(LightSensorObject* self, float* lux, int64_t* timestamp) {
+    pthread_mutex_lock(&self->read_lock);
+    if (self->reading) {
+        uint64_t generation = self->read_generation;
+        while (self->read_generation == generation) pthread_cond_wait(&self->read_done, &self->read_lock);
+        LuxStatus status = (LuxStatus)self->shared_status;
+        *lux = self->shared_lux;
+        *timestamp = self->shared_timestamp;
+        pthread_mutex_unlock(&self->read_lock);
+        return status;
+    }
+    self->reading = 1;
+    io_service_t service = self->service;
+    if (service) IOObjectRetain(service);
+    pthread_mutex_unlock(&self->read_lock);
+
+    *lux = 0;
+    *timestamp = monotonic_ns();
+    LuxStatus status = read_current_lux(service, lux);
+    if (service) IOObjectRelease(service);
+    if (status == LUX_OK) {
+        os_unfair_lock_lock(&self->ring_lock);
+        SampleRing_push(&self->ring, *timestamp, *lux);
+        os_unfair_lock_unlock(&self->ring_lock);
+    }
+
+    pthread_mutex_lock(&self->read_lock);
+    self->shared_lux = *lux;
+    self->shared_status = status;
+    self->shared_timestamp = *timestamp;
+    self->reading = 0;
+    self->read_generation++;
+    pthread_cond_broadcast(&self->read_done);
+    pthread_mutex_unlock(&self->read_lock);
+    return status;
+}
+
+static PyObject* LightSensor_get_current_lux(LightSensorObject* self, PyObject* Py_UNUSED(ignored)) {
+    float lux;
+    int64_t timestamp;
+    LuxStatus status;
+    Py_BEGIN_ALLOW_THREADS
+    status = LightSensor_read(self, &lux, &timestamp);
+    Py_END_ALLOW_THREADS
+    if (status != LUX_OK) {
+        PyErr_SetString(PyExc_RuntimeError, lux_status_messages[status]);
+        return NULL;
+    }
+    return PyFloat_FromDouble(lux);
+}
+
+static PyObject* LightSensor_record(LightSensorObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"capacity", "format", NULL};
+    Py_ssize_t capacity;
+    const char* format_name = "float64";
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n|s", kwlist, &capacity, &format_name)) return NULL;
+
+    if (capacity < 0) {
+        PyErr_SetString(PyExc_ValueError, "capacity must not be negative.");
+        return NULL;
+    }
+    int format = 0;
+    while (ring_format_names[format] && strcmp(ring_format_names[format], format_name) != 0) format++;
+    if (!ring_format_names[format]) {
+        PyErr_SetString(PyExc_ValueError, "format must be 'float64', 'float32', 'float16' or 'uint16'.");
+        return NULL;
+    }
+    if (self->ring.views) {
+        PyErr_SetString(PyExc_BufferError, "Cannot resize the recording ring while views from acquire() exist.");
+        return NULL;
+    }
+    os_unfair_lock_lock(&self->ring_lock);
+    int rc = SampleRing_init(&self->ring, capacity, (RingFormat)format);
+    os_unfair_lock_unlock(&self->ring_lock);
+    if (rc < 0) return PyErr_NoMemory();
+    Py_RETURN_NONE;
+}
+
+static PyObject* LightSensor_drain(LightSensorObject* self, PyObject* args) {
+    Py_ssize_t max_samples = -1;
+    if (!PyArg_ParseTuple(args, "|n", &max_samples)) return NULL;
+
+    if (self->ring.leased) {
+        PyErr_SetString(PyExc_BufferError, "Cannot drain while samples are acquired; release() them first.");
+        return NULL;
+    }
+
+    SampleBuf out = {0};
+    os_unfair_lock_lock(&self->ring_lock);
+    int rc = SampleRing_drain(&self->ring, max_samples, &out);
+    os_unfair_lock_unlock(&self->ring_lock);
+    if (rc < 0) {
+        SampleBuf_clear(&out);
+        return PyErr_NoMemory();
+    }
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* LightSensor_repr(LightSensorObject* self) {
+    return PyUnicode_FromFormat("LightSensor('%s')", self->service_name);
+}
+
+static uint64_t hash_name(const char* name) {
+    uint64_t h = 1469598103934665603ULL;
+    for (; *name; name++) {
+        h = (h ^ (unsigned char)*name) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Resolves every name to its service in a single walk of the registry. The
+ * walk is narrowed in the kernel by matching on the names; a hash set of the
+ * requested names finds the slot of each candidate. Unmatched names are left
+ * as MACH_PORT_NULL. Returns -1 with an exception set on IOKit failures. */
+static int resolve_services(const char** names, Py_ssize_t count, io_service_t* services) {
+    if (count == 0) return 0;
+
+    Py_ssize_t buckets = 8;
+    while (buckets < count * 2) buckets *= 2;
+
+    Py_ssize_t* table = PyMem_RawMalloc(buckets * sizeof(Py_ssize_t));
+    CFStringRef* cf_names = PyMem_RawCalloc(count ? count : 1, sizeof(CFStringRef));
+    if (!table || !cf_names) {
+        PyMem_RawFree(table);
+        PyMem_RawFree(cf_names);
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(table, 0xff, buckets * sizeof(Py_ssize_t));
+
+    Py_ssize_t unique = 0;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        services[i] = MACH_PORT_NULL;
+        Py_ssize_t b = hash_name(names[i]) & (buckets - 1);
+        while (table[b] >= 0 && strcmp(names[table[b]], names[i]) != 0) b = (b + 1) & (buckets - 1);
+        if (table[b] < 0) {
+            table[b] = i;
+            cf_names[unique++] = CFStringCreateWithCString(kCFAllocatorDefault, names[i], kCFStringEncodingUTF8);
+        }
+    }
+
+    CFMutableDictionaryRef matchingDict = IOServiceMatching("IOService");
+    if (matchingDict) {
+        CFArrayRef nameArray = CFArrayCreate(kCFAllocatorDefault, (const void**)cf_names, unique, &kCFTypeArrayCallBacks);
+        if (nameArray) {
+            CFDictionarySetValue(matchingDict, CFSTR(kIONameMatchKey), nameArray);
+            CFRelease(nameArray);
+        }
+    }
+    for (Py_ssize_t i = 0; i < unique; i++) {
+        if (cf_names[i]) CFRelease(cf_names[i]);
+    }
+    PyMem_RawFree(cf_names);
+
+    if (!matchingDict) {
+        PyMem_RawFree(table);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to create matching dictionary.");
+        return -1;
+    }
+
+    io_iterator_t iter;
+    kern_return_t kr = IOServiceGetMatchingServices(kIOMainPortDefault, matchingDict, &iter);
+    if (kr != KERN_SUCCESS || !iter) {
+        PyMem_RawFree(table);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get matching services.");
+        return -1;
+    }
+
+    Py_ssize_t remaining = unique;
+    io_service_t candidate;
+    char serviceName[128];
+
+    while (remaining && (candidate = IOIteratorNext(iter))) {
+        Py_ssize_t found = -1;
+        if (IORegistryEntryGetName(candidate, serviceName) == KERN_SUCCESS) {
+            Py_ssize_t b = hash_name(serviceName) & (buckets - 1);
+            while (table[b] >= 0 && strcmp(names[table[b]], serviceName) != 0) b = (b + 1) & (buckets - 1);
+            found = table[b];
+        }
+        if (found >= 0 && services[found] == MACH_PORT_NULL) {
+            services[found] = candidate;
+            remaining--;
+        } else {
+            IOObjectRelease(candidate);
+        }
+    }
+    IOObjectRelease(iter);
+
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Py_ssize_t b = hash_name(names[i]) & (buckets - 1);
+        while (strcmp(names[table[b]], names[i]) != 0) b = (b + 1) & (buckets - 1);
+        if (table[b] != i && services[table[b]] != MACH_PORT_NULL) {
+            services[i] = services[table[b]];
+            IOObjectRetain(services[i]);
+        }
+    }
+
+    PyMem_RawFree(table);
+    return 0;
+}
+
+static int LightSensor_init(LightSensorObject* self, PyObject* args, PyObject* kwds) {
+    const char* name = NULL;
+    if (!PyArg_ParseTuple(args, "s", &name)) {
+        PyErr_SetString(PyExc_TypeError, "Expected service name as a string.");
+        return -1;
+    }
+
+    io_service_t service;
+    if (resolve_services(&name, 1, &service) < 0) return -1;
+
+    if (service == MACH_PORT_NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Service not found.");
+        return -1;
+    }
+
+    pthread_mutex_lock(&self->read_lock);
+    io_service_t old = self->service;
+    self->service = service;
+    pthread_mutex_unlock(&self->read_lock);
+    if (old != MACH_PORT_NULL) IOObjectRelease(old);
+
+    snprintf(self->service_name, sizeof(self->service_name), "%s", name);
+    return 0;
+}
+
+/* Takes ownership of service. */
+static PyObject* LightSensor_from_service(io_service_t service, const char* name) {
+    LightSensorObject* sensor = (LightSensorObject*)LightSensor_new(&LightSensorType, NULL, NULL);
+    if (!sensor) {
+        IOObjectRelease(service);
+        return NULL;
+    }
+
+    sensor->service = service;
+    snprintf(sensor->service_name, sizeof(sensor->service_name), "%s", name);
+    return (PyObject*)sensor;
+}
+
+static PyObject* LightSensor_open_many(PyObject* cls, PyObject* arg) {
+    PyObject* seq = PySequence_Fast(arg, "Expected a sequence of service names.");
+    if (!seq) return NULL;
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    const char** names = PyMem_RawMalloc((count ? count : 1) * sizeof(char*));
+    io_service_t* services = PyMem_RawMalloc((count ? count : 1) * sizeof(io_service_t));
+    PyObject* result = NULL;
+    if (!names || !services) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    for (Py_ssize_t i = 0; i < count; i++) {
+        names[i] = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+        if (!names[i]) goto done;
+    }
+
+    if (resolve_services(names, count, services) < 0) goto done;
+
+    result = PyList_New(count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (result && services[i] == MACH_PORT_NULL) {
+            PyErr_Format(PyExc_RuntimeError, "Service '%s' not found.", names[i]);
+            Py_CLEAR(result);
+        }
+        if (!result) {
+            if (services[i] != MACH_PORT_NULL) IOObjectRelease(services[i]);
+            continue;
+        }
+
+        PyObject* sensor = LightSensor_from_service(services[i], names[i]);
+        if (!sensor) {
+            Py_CLEAR(result);
+            continue;
+        }
+        PyList_SET_ITEM(result, i, sensor);
+    }
+
+done:
+    PyMem_RawFree(names);
+    PyMem_RawFree(services);
+    Py_DECREF(seq);
+    return result;
+}
+
+static PyObject* LightSensor_get_name(LightSensorObject* self, void* closure) {
+    return PyUnicode_FromString(self->service_name);
+}
+
+static PyObject* LightSensor_get_registry_id(LightSensorObject* self, void* closure) {
+    uint64_t entry;
+    if (!self->service || IORegistryEntryGetRegistryEntryID(self->service, &entry) != KERN_SUCCESS) {
+        PyErr_SetString(PyExc_RuntimeError, lux_status_messages[LUX_NO_SERVICE]);
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(entry);
+}
+
+static PyObject* LightSensor_history(LightSensorObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"since_ns", "until_ns", NULL};
+    long long since = INT64_MIN, until = INT64_MAX;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|LL", kwlist, &since, &until)) return NULL;
+
+    SampleBuf out = {0};
+    os_unfair_lock_lock(&self->ring_lock);
+    int rc = SampleRing_history(&self->ring, since, until, &out);
+    os_unfair_lock_unlock(&self->ring_lock);
+    if (rc < 0) {
+        SampleBuf_clear(&out);
+        return PyErr_NoMemory();
+    }
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* LightSensor_ring_segment(LightSensorObject* self, Py_ssize_t slot, Py_ssize_t count) {
+    SampleColumnObject* ts_column = SampleColumn_borrow((PyObject*)self, &self->ring.views, self->ring.timestamps + slot, count, 'q');
+    if (!ts_column) return NULL;
+
+    SampleColumnObject* value_column = SampleColumn_borrow((PyObject*)self, &self->ring.views, self->ring.values + slot, count, 'd');
+    if (!value_column) {
+        Py_DECREF(ts_column);
+        return NULL;
+    }
+    return SampleBatch_from_columns(ts_column, value_column);
+}
+
+static PyObject* LightSensor_acquire(LightSensorObject* self, PyObject* args) {
+    Py_ssize_t max_samples = -1;
+    if (!PyArg_ParseTuple(args, "|n", &max_samples)) return NULL;
+
+    SampleRing* ring = &self->ring;
+    if (ring->format != RING_FLOAT64) {
+        PyErr_SetString(PyExc_BufferError, "acquire() needs a ring recorded with format='float64'.");
+        return NULL;
+    }
+
+    os_unfair_lock_lock(&self->ring_lock);
+    Py_ssize_t count = (Py_ssize_t)(ring->head - ring->tail);
+    if (max_samples >= 0 && max_samples < count) count = max_samples;
+    Py_ssize_t slot = count ? ring->tail % ring->slots : 0;
+    Py_ssize_t previous = ring->leased;
+    if (count > previous) ring->leased = count;
+    os_unfair_lock_unlock(&self->ring_lock);
+
+    if (count == 0) return PyTuple_New(0);
+
+    Py_ssize_t first = count < ring->slots - slot ? count : ring->slots - slot;
+    PyObject* result = PyTuple_New(first < count ? 2 : 1);
+    PyObject* segment = result ? LightSensor_ring_segment(self, slot, first) : NULL;
+    if (segment) {
+        PyTuple_SET_ITEM(result, 0, segment);
+        if (first < count) {
+            segment = LightSensor_ring_segment(self, 0, count - first);
+            if (segment) PyTuple_SET_ITEM(result, 1, segment);
+        }
+    }
+
+    if (!segment) {
+        Py_XDECREF(result);
+        os_unfair_lock_lock(&self->ring_lock);
+        ring->leased = previous;
+        os_unfair_lock_unlock(&self->ring_lock);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* LightSensor_release(LightSensorObject* self, PyObject* args) {
+    Py_ssize_t count;
+    if (!PyArg_ParseTuple(args, "n", &count)) return NULL;
+
+    os_unfair_lock_lock(&self->ring_lock);
+    int valid = count >= 0 && count <= self->ring.leased;
+    if (valid) {
+        self->ring.tail += count;
+        self->ring.leased -= count;
+    }
+    os_unfair_lock_unlock(&self->ring_lock);
+    if (!valid) {
+        PyErr_SetString(PyExc_ValueError, "Cannot release more samples than were acquired.");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* LightSensor_get_pending(LightSensorObject* self, void* closure) {
+    os_unfair_lock_lock(&self->ring_lock);
+    uint64_t pending = self->ring.head - self->ring.tail;
+    os_unfair_lock_unlock(&self->ring_lock);
+    return PyLong_FromUnsignedLongLong(pending);
+}
+
+static PyObject* LightSensor_get_dropped(LightSensorObject* self, void* closure) {
+    os_unfair_lock_lock(&self->ring_lock);
+    uint64_t dropped = self->ring.dropped;
+    os_unfair_lock_unlock(&self->ring_lock);
+    return PyLong_FromUnsignedLongLong(dropped);
+}
+
+static PyGetSetDef LightSensor_getset[] = {
+    {"name", (getter)LightSensor_get_name, NULL, "service name of the ambient light sensor", NULL},
+    {"registry_id", (getter)LightSensor_get_registry_id, NULL, "IORegistry entry ID of the sensor service, usable with read_once()", NULL},
+    {"pending", (getter)LightSensor_get_pending, NULL, "number of recorded samples not drained yet", NULL},
+    {"dropped", (getter)LightSensor_get_dropped, NULL, "number of recorded samples overwritten before being drained", NULL},
+    {NULL}
+};
+
+static PyMethodDef LightSensor_methods[] = {
+    {"get_current_lux", (PyCFunction)LightSensor_get_current_lux, METH_NOARGS, PyDoc_STR("Get the lux value of ambient light sensor.")},
+    {"open_many", (PyCFunction)LightSensor_open_many, METH_O | METH_CLASS, PyDoc_STR("Open a LightSensor for each service name with a single registry walk.")},
+    {"record", (PyCFunction)(void(*)(void))LightSensor_record, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Record every reading into a ring of the given capacity (0 stops recording), storing values as format.")},
+    {"drain", (PyCFunction)LightSensor_drain, METH_VARARGS, PyDoc_STR("Remove up to max_samples recorded readings (default all) and return them as a SampleBatch.")},
+    {"history", (PyCFunction)(void(*)(void))LightSensor_history, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Return the recorded readings with since_ns <= timestamp < until_ns as a SampleBatch, drained or not.")},
+    {"acquire", (PyCFunction)LightSensor_acquire, METH_VARARGS, PyDoc_STR("Return up to max_samples unread readings as one or two SampleBatch views into the ring, without copying.")},
+    {"release", (PyCFunction)LightSensor_release, METH_VARARGS, PyDoc_STR("Mark the first n acquired readings as consumed; the rest stay acquired.")},
+    {NULL}
+};
+
+static void LightSensorIterator_dealloc(LightSensorIterator* self) {
+    for (Py_ssize_t i = self->batch_pos; i < self->batch_len; i++) {
+        IOObjectRelease(self->batch[i].service);
+    }
+    PyMem_RawFree(self->batch);
+    if (self->iter) {
+        IOObjectRelease(self->iter);
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+#define DISCOVERY_FIRST_BATCH 32
+#define DISCOVERY_MAX_BATCH 1024
+
+static void discovery_check(void* context, size_t i) {
+    DiscoveryCandidate* candidate = &((DiscoveryCandidate*)context)[i];
+    CFTypeRef luxValue = IORegistryEntryCreateCFProperty(candidate->service, CFSTR("CurrentLux"), kCFAllocatorDefault, 0);
+    candidate->is_sensor = luxValue && IORegistryEntryGetName(candidate->service, candidate->name) == KERN_SUCCESS;
+    if (luxValue) CFRelease(luxValue);
+}
+
+/* Pulls the next batch of candidates off the registry iterator and checks
+ * them for a CurrentLux property on the dispatch thread pool. Batches start
+ * small so find_sensor() stays quick and grow for long walks. The batch is
+ * written without the GIL, so `filling` keeps other threads out of it. */
+static int LightSensorIterator_fill(LightSensorIterator* self) {
+    Py_ssize_t size = self->batch_size ? self->batch_size * 2 : DISCOVERY_FIRST_BATCH;
+    if (size > DISCOVERY_MAX_BATCH) size = DISCOVERY_MAX_BATCH;
+    if (size != self->batch_size) {
+        DiscoveryCandidate* batch = PyMem_RawRealloc(self->batch, size * sizeof(DiscoveryCandidate));
+        if (!batch) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->batch = batch;
+        self->batch_size = size;
+    }
+
+    Py_ssize_t len = 0;
+    self->filling = 1;
+    Py_BEGIN_ALLOW_THREADS
+    io_service_t service;
+    while (len < size && (service = IOIteratorNext(self->iter))) {
+        self->batch[len++].service = service;
+    }
+    dispatch_apply_f(len, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), self->batch, discovery_check);
+    Py_END_ALLOW_THREADS
+    self->filling = 0;
+
+    self->batch_len = len;
+    self->batch_pos = 0;
+    return 0;
+}
+
+static PyObject* LightSensorIterator_next(LightSensorIterator* self) {
+    if (self->filling) {
+        PyErr_SetString(PyExc_ValueError, "list_sensors() iterator already executing");
+        return NULL;
+    }
+
+    for (;;) {
+        if (self->batch_pos == self->batch_len) {
+            if (LightSensorIterator_fill(self) < 0) return NULL;
+            if (self->batch_len == 0) break;
+        }
+
+        DiscoveryCandidate* candidate = &self->batch[self->batch_pos++];
+        if (candidate->is_sensor) {
+            return LightSensor_from_service(candidate->service, candidate->name);
+        }
+        IOObjectRelease(candidate->service);
+    }
+
+    PyErr_SetNone(PyExc_StopIteration);
+    return NULL;
+}
+
+static PyObject* LightSensorIterator_iter(PyObject* self) {
+    Py_INCREF(self);
+    return self;
+}
+
+static PyTypeObject LightSensorIteratorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals._LightSensorIterator",
+    .tp_basicsize = sizeof(LightSensorIterator),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Iterator over LightSensor objects (internal use only)",
+    .tp_iter = LightSensorIterator_iter,
+    .tp_iternext = (iternextfunc)LightSensorIterator_next,
+    .tp_dealloc = (destructor)LightSensorIterator_dealloc,
+};
+
+/* A column argument is either a 1-D C-contiguous buffer of the expected item
+ * type (read in place) or any sequence of numbers (converted into data). */
+typedef struct {
+    Py_buffer view;
+    void* data;
+    Py_ssize_t length;
+    int owned;
+} ColumnArg;
+
+static int ColumnArg_load(PyObject* obj, char format, ColumnArg* arg) {
+    memset(arg, 0, sizeof(*arg));
+
+    if (PyObject_CheckBuffer(obj) && PyObject_GetBuffer(obj, &arg->view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == 0) {
+        const char* fmt = arg->view.format ? arg->view.format : "B";
+        if (*fmt == '@' || *fmt == '=' || *fmt == '<') fmt++;
+        int ok = arg->view.ndim == 1 && arg->view.itemsize == 8 &&
+                 (format == 'd' ? strcmp(fmt, "d") == 0 : (strcmp(fmt, "q") == 0 || strcmp(fmt, "l") == 0));
+        if (ok) {
+            arg->data = arg->view.buf;
+            arg->length = arg->view.shape ? arg->view.shape[0] : arg->view.len / 8;
+            return 0;
+        }
+        PyBuffer_Release(&arg->view);
+    }
+    PyErr_Clear();
+
+    PyObject* seq = PySequence_Fast(obj, "expected a sequence or buffer of numbers");
+    if (!seq) return -1;
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    PyObject** items = PySequence_Fast_ITEMS(seq);
+    arg->data = PyMem_RawMalloc(n ? n * 8 : 1);
+    if (!arg->data) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    arg->owned = 1;
+    arg->length = n;
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        if (format == 'd') {
+            ((double*)arg->data)[i] = PyFloat_AsDouble(items[i]);
+        } else {
+            ((int64_t*)arg->data)[i] = PyLong_AsLongLong(items[i]);
+        }
+        if (PyErr_Occurred()) {
+            Py_DECREF(seq);
+            PyMem_RawFree(arg->data);
+            arg->data = NULL;
+            return -1;
+        }
+    }
+
+    Py_DECREF(seq);
+    return 0;
+}
+
+static void ColumnArg_release(ColumnArg* arg) {
+    if (arg->owned) {
+        PyMem_RawFree(arg->data);
+    } else if (arg->data) {
+        PyBuffer_Release(&arg->view);
+    }
+    arg->data = NULL;
+}
+
+static int ColumnArg_load_samples(PyObject* ts_obj, PyObject* values_obj, ColumnArg* ts, ColumnArg* vals) {
+    if (ColumnArg_load(ts_obj, 'q', ts) < 0) return -1;
+    if (ColumnArg_load(values_obj, 'd', vals) < 0) {
+        ColumnArg_release(ts);
+        return -1;
+    }
+    if (ts->length != vals->length) {
+        ColumnArg_release(ts);
+        ColumnArg_release(vals);
+        PyErr_SetString(PyExc_ValueError, "timestamps and values must have the same length.");
+        return -1;
+    }
+    return 0;
+}
+
+typedef enum {
+    RESAMPLE_LINEAR,
+    RESAMPLE_HOLD,
+    RESAMPLE_CUBIC,
+} ResampleMethod;
+
+static const char* resample_method_names[] = {"linear", "hold", "cubic"};
+
+static int parse_resample_method(const char* name, ResampleMethod* method) {
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(name, resample_method_names[i]) == 0) {
+            *method = (ResampleMethod)i;
+            return 0;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown resampling method '%s' (expected linear, hold or cubic).", name);
+    return -1;
+}
+
+#define RESAMPLE_ERR_MEMORY -1
+#define RESAMPLE_ERR_ORDER -2
+
+static void set_resample_error(int rc) {
+    if (rc == RESAMPLE_ERR_ORDER) {
+        PyErr_SetString(PyExc_ValueError, "Timestamps must be non-decreasing.");
+    } else {
+        PyErr_NoMemory();
+    }
+}
+
+/* Streaming resampler onto the grid k * interval. Input points are buffered
+ * until the segment they close can be interpolated: linear and hold emit a
+ * segment as soon as its right end arrives, cubic one point later because it
+ * needs the slope at the right end. */
+typedef struct {
+    ResampleMethod method;
+    int64_t interval;
+    int64_t max_gap;
+    int64_t next_grid;
+    int64_t t[4];
+    double v[4];
+    int count;
+} ResampleState;
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+static double hermite_slope(const ResampleState* st, int i) {
+    int lo = i > 0 ? i - 1 : i;
+    int hi = i + 1 < st->count ? i + 1 : i;
+    if (st->t[hi] == st->t[lo]) return 0.0;
+    return (st->v[hi] - st->v[lo]) / (double)(st->t[hi] - st->t[lo]);
+}
+
+/* Emit every grid point in [t[i], t[i + 1]). */
+static int resample_segment(ResampleState* st, int i, SampleBuf* out) {
+    int64_t t0 = st->t[i], t1 = st->t[i + 1];
+    double v0 = st->v[i], v1 = st->v[i + 1];
+    double span = (double)(t1 - t0);
+    int gap = st->max_gap > 0 && t1 - t0 > st->max_gap;
+    double m0 = 0.0, m1 = 0.0;
+
+    if (st->method == RESAMPLE_CUBIC) {
+        m0 = hermite_slope(st, i) * span;
+        m1 = hermite_slope(st, i + 1) * span;
+    }
+
+    for (; st->next_grid < t1; st->next_grid += st->interval) {
+        double x = (double)(st->next_grid - t0) / span;
+        double value;
+        if (gap) {
+            value = NAN;
+        } else if (st->method == RESAMPLE_HOLD) {
+            value = v0;
+        } else if (st->method == RESAMPLE_LINEAR) {
+            value = v0 + (v1 - v0) * x;
+        } else {
+            double x2 = x * x, x3 = x2 * x;
+            value = (2 * x3 - 3 * x2 + 1) * v0 + (x3 - 2 * x2 + x) * m0 +
+                    (-2 * x3 + 3 * x2) * v1 + (x3 - x2) * m1;
+        }
+        if (SampleBuf_append(out, st->next_grid, value) < 0) return -1;
+    }
+    return 0;
+}
+
+static int resample_push(ResampleState* st, int64_t t, double v, SampleBuf* out) {
+    if (st->count == 0) {
+        st->next_grid = (floor_div(t - 1, st->interval) + 1) * st->interval;
+    } else {
+        int64_t last = st->t[st->count - 1];
+        if (t < last) return RESAMPLE_ERR_ORDER;
+        if (t == last) {
+            st->v[st->count - 1] = v;
+            return 0;
+        }
+    }
+
+    if (st->count == 4) {
+        memmove(st->t, st->t + 1, 3 * sizeof(int64_t));
+        memmove(st->v, st->v + 1, 3 * sizeof(double));
+        st->count = 3;
+    }
+    st->t[st->count] = t;
+    st->v[st->count] = v;
+    st->count++;
+
+    if (st->method == RESAMPLE_CUBIC) {
+        return st->count >= 3 ? resample_segment(st, st->count - 3, out) : 0;
+    }
+    return st->count >= 2 ? resample_segment(st, st->count - 2, out) : 0;
+}
+
+static int resample_flush(ResampleState* st, SampleBuf* out) {
+    if (st->count == 0) return 0;
+
+    if (st->method == RESAMPLE_CUBIC && st->count >= 2) {
+        if (resample_segment(st, st->count - 2, out) < 0) return RESAMPLE_ERR_MEMORY;
+    }
+
+    int64_t last = st->t[st->count - 1];
+    if (st->next_grid == last) {
+        if (SampleBuf_append(out, last, st->v[st->count - 1]) < 0) return RESAMPLE_ERR_MEMORY;
+    }
+
+    st->count = 0;
+    return 0;
+}
+
+static int resample_columns(ResampleState* st, const ColumnArg* ts, const ColumnArg* vals, SampleBuf* out) {
+    for (Py_ssize_t i = 0; i < ts->length; i++) {
+        int rc = resample_push(st, ((int64_t*)ts->data)[i], ((double*)vals->data)[i], out);
+        if (rc < 0) return rc;
+    }
+    return 0;
+}
+
+static int resample_state_init(ResampleState* st, long long interval, long long max_gap, const char* method) {
+    memset(st, 0, sizeof(*st));
+    if (interval <= 0) {
+        PyErr_SetString(PyExc_ValueError, "interval_ns must be positive.");
+        return -1;
+    }
+    if (parse_resample_method(method, &st->method) < 0) return -1;
+    st->interval = interval;
+    st->max_gap = max_gap;
+    return 0;
+}
+
+typedef struct {
+    PyObject_HEAD
+    ResampleState state;
+} ResamplerObject;
+
+static int Resampler_init(ResamplerObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"interval_ns", "method", "max_gap_ns", NULL};
+    long long interval = 0, max_gap = 0;
+    const char* method = "linear";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "L|sL", kwlist, &interval, &method, &max_gap)) {
+        return -1;
+    }
+    return resample_state_init(&self->state, interval, max_gap, method);
+}
+
+static PyObject* Resampler_push(ResamplerObject* self, PyObject* args) {
+    long long timestamp;
+    double value;
+    if (check_initialized(self, self->state.interval > 0) < 0) return NULL;
+    if (!PyArg_ParseTuple(args, "Ld", &timestamp, &value)) return NULL;
+
+    SampleBuf out = {0};
+    int rc = resample_push(&self->state, timestamp, value, &out);
+    if (rc < 0) {
+        set_resample_error(rc);
+        SampleBuf_clear(&out);
+        return NULL;
+    }
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* Resampler_extend(ResamplerObject* self, PyObject* args) {
+    PyObject *ts_obj, *values_obj;
+    if (check_initialized(self, self->state.interval > 0) < 0) return NULL;
+    if (!PyArg_ParseTuple(args, "OO", &ts_obj, &values_obj)) return NULL;
+
+    ColumnArg ts, vals;
+    if (ColumnArg_load_samples(ts_obj, values_obj, &ts, &vals) < 0) return NULL;
+
+    SampleBuf out = {0};
+    int rc = resample_columns(&self->state, &ts, &vals, &out);
+    ColumnArg_release(&ts);
+    ColumnArg_release(&vals);
+    if (rc < 0) {
+        set_resample_error(rc);
+        SampleBuf_clear(&out);
+        return NULL;
+    }
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* Resampler_flush(ResamplerObject* self, PyObject* Py_UNUSED(ignored)) {
+    if (check_initialized(self, self->state.interval > 0) < 0) return NULL;
+    SampleBuf out = {0};
+    if (resample_flush(&self->state, &out) < 0) {
+        PyErr_NoMemory();
+        SampleBuf_clear(&out);
+        return NULL;
+    }
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* Resampler_get_interval(ResamplerObject* self, void* closure) {
+    return PyLong_FromLongLong(self->state.interval);
+}
+
+static PyObject* Resampler_get_method(ResamplerObject* self, void* closure) {
+    return PyUnicode_FromString(resample_method_names[self->state.method]);
+}
+
+static PyGetSetDef Resampler_getset[] = {
+    {"interval_ns", (getter)Resampler_get_interval, NULL, "grid spacing in nanoseconds", NULL},
+    {"method", (getter)Resampler_get_method, NULL, "interpolation method", NULL},
+    {NULL}
+};
+
+static PyMethodDef Resampler_methods[] = {
+    {"push", (PyCFunction)Resampler_push, METH_VARARGS, PyDoc_STR("Add one (timestamp_ns, value) sample and return the grid samples it completes.")},
+    {"extend", (PyCFunction)Resampler_extend, METH_VARARGS, PyDoc_STR("Add columns of timestamps and values and return the grid samples they complete.")},
+    {"flush", (PyCFunction)Resampler_flush, METH_NOARGS, PyDoc_STR("Emit the remaining grid samples and reset the stream.")},
+    {NULL}
+};
+
+static PyTypeObject ResamplerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.Resampler",
+    .tp_basicsize = sizeof(ResamplerObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Streaming resampler of irregular samples onto a fixed-rate grid",
+    .tp_methods = Resampler_methods,
+    .tp_getset = Resampler_getset,
+    .tp_init = (initproc)Resampler_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* Windowed flicker analysis. Every sample updates one Goertzel filter per
+ * frequency bin of a Hann-weighted window, so the spectrum is ready when the
+ * window closes and only the flicker index needs a pass over the samples.
+ * The filters are linear, so the DC leakage of the window into low bins is
+ * removed at the end by subtracting mean * (response of the bare window). */
+typedef struct {
+    int64_t timestamp;
+    double frequency;
+    double percent;
+    double index;
+    double mean;
+} FlickerResult;
+
+typedef struct {
+    double sample_rate;
+    Py_ssize_t window;
+    Py_ssize_t bin_lo;
+    Py_ssize_t bin_hi;
+    double* weights;
+    double* coeffs;
+    double* s1;
+    double* s2;
+    double* dc1;
+    double* dc2;
+    double* samples;
+    Py_ssize_t pos;
+} FlickerState;
+
+static void flicker_state_clear(FlickerState* st) {
+    PyMem_RawFree(st->weights);
+    PyMem_RawFree(st->coeffs);
+    PyMem_RawFree(st->s1);
+    PyMem_RawFree(st->s2);
+    PyMem_RawFree(st->dc1);
+    PyMem_RawFree(st->dc2);
+    PyMem_RawFree(st->samples);
+    memset(st, 0, sizeof(*st));
+}
+
+static int flicker_state_init(FlickerState* st, double sample_rate, Py_ssize_t window, double min_hz, double max_hz) {
+    memset(st, 0, sizeof(*st));
+    if (sample_rate <= 0) {
+        PyErr_SetString(PyExc_ValueError, "sample_rate_hz must be positive.");
+        return -1;
+    }
+    if (window < 8 || window > 65536) {
+        PyErr_SetString(PyExc_ValueError, "window must be between 8 and 65536 samples.");
+        return -1;
+    }
+
+    double resolution = sample_rate / (double)window;
+    st->bin_lo = min_hz > 0 ? (Py_ssize_t)ceil(min_hz / resolution) : 1;
+    st->bin_hi = max_hz > 0 ? (Py_ssize_t)floor(max_hz / resolution) : window / 2;
+    if (st->bin_lo < 1) st->bin_lo = 1;
+    if (st->bin_hi > window / 2) st->bin_hi = window / 2;
+    if (st->bin_lo > st->bin_hi) {
+        PyErr_SetString(PyExc_ValueError, "No frequency bins between min_hz and max_hz at this window size.");
+        return -1;
+    }
+
+    st->sample_rate = sample_rate;
+    st->window = window;
+
+    Py_ssize_t bins = st->bin_hi - st->bin_lo + 1;
+    st->weights = PyMem_RawMalloc(window * sizeof(double));
+    st->samples = PyMem_RawMalloc(window * sizeof(double));
+    st->coeffs = PyMem_RawMalloc(bins * sizeof(double));
+    st->s1 = PyMem_RawCalloc(bins, sizeof(double));
+    st->s2 = PyMem_RawCalloc(bins, sizeof(double));
+    st->dc1 = PyMem_RawMalloc(bins * sizeof(double));
+    st->dc2 = PyMem_RawMalloc(bins * sizeof(double));
+    if (!st->weights || !st->samples || !st->coeffs || !st->s1 || !st->s2 || !st->dc1 || !st->dc2) {
+        flicker_state_clear(st);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    for (Py_ssize_t i = 0; i < window; i++) {
+        st->weights[i] = 0.5 - 0.5 * cos(2.0 * M_PI * (double)i / (double)(window - 1));
+    }
+    for (Py_ssize_t b = 0; b < bins; b++) {
+        st->coeffs[b] = 2.0 * cos(2.0 * M_PI * (double)(st->bin_lo + b) / (double)window);
+        double s1 = 0.0, s2 = 0.0;
+        for (Py_ssize_t i = 0; i < window; i++) {
+            double s = st->weights[i] + st->coeffs[b] * s1 - s2;
+            s2 = s1;
+            s1 = s;
+        }
+        st->dc1[b] = s1;
+        st->dc2[b] = s2;
+    }
+    return 0;
+}
+
+static void flicker_finish(FlickerState* st, int64_t timestamp, FlickerResult* out) {
+    Py_ssize_t n = st->window;
+    Py_ssize_t bins = st->bin_hi - st->bin_lo + 1;
+    double lo = st->samples[0], hi = st->samples[0], sum = 0.0;
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        double x = st->samples[i];
+        if (x < lo) lo = x;
+        if (x > hi) hi = x;
+        sum += x;
+    }
+
+    double mean = sum / (double)n;
+    double above = 0.0;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        if (st->samples[i] > mean) above += st->samples[i] - mean;
+    }
+
+    Py_ssize_t peak = 0;
+    double peak_power = -1.0;
+    double* power = st->s1;
+    for (Py_ssize_t b = 0; b < bins; b++) {
+        double s1 = st->s1[b] - mean * st->dc1[b];
+        double s2 = st->s2[b] - mean * st->dc2[b];
+        power[b] = s1 * s1 + s2 * s2 - st->coeffs[b] * s1 * s2;
+        if (power[b] > peak_power) {
+            peak_power = power[b];
+            peak = b;
+        }
+    }
+
+    double offset = 0.0;
+    if (peak > 0 && peak < bins - 1) {
+        double l = power[peak - 1], c = power[peak], r = power[peak + 1];
+        double denom = l - 2.0 * c + r;
+        if (denom != 0.0) offset = 0.5 * (l - r) / denom;
+    }
+
+    out->timestamp = timestamp;
+    out->mean = mean;
+    out->percent = hi + lo > 0 ? 100.0 * (hi - lo) / (hi + lo) : 0.0;
+    out->index = sum > 0 ? above / sum : 0.0;
+    out->frequency = hi > lo ? ((double)(st->bin_lo + peak) + offset) * st->sample_rate / (double)n : 0.0;
+
+    memset(st->s1, 0, bins * sizeof(double));
+    memset(st->s2, 0, bins * sizeof(double));
+    st->pos = 0;
+}
+
+/* Returns 1 and fills out when the sample completes a window. */
+static int flicker_push(FlickerState* st, int64_t timestamp, double value, FlickerResult* out) {
+    Py_ssize_t bins = st->bin_hi - st->bin_lo + 1;
+    double x = value * st->weights[st->pos];
+    double* s1 = st->s1;
+    double* s2 = st->s2;
+    const double* coeffs = st->coeffs;
+
+    for (Py_ssize_t b = 0; b < bins; b++) {
+        double s = x + coeffs[b] * s1[b] - s2[b];
+        s2[b] = s1[b];
+        s1[b] = s;
+    }
+
+    st->samples[st->pos++] = value;
+    if (st->pos < st->window) return 0;
+
+    flicker_finish(st, timestamp, out);
+    return 1;
+}
+
+static PyTypeObject* FlickerWindowType;
+
+static PyStructSequence_Field FlickerWindow_fields[] = {
+    {"timestamp_ns", "timestamp of the last sample in the window"},
+    {"frequency_hz", "dominant flicker frequency, 0.0 when the window is flat"},
+    {"percent", "percent flicker, 100 * (max - min) / (max + min)"},
+    {"index", "flicker index, area above the mean over total area"},
+    {"mean", "mean lux over the window"},
+    {NULL}
+};
+
+static PyStructSequence_Desc FlickerWindow_desc = {
+    "_macals.FlickerWindow",
+    "Flicker metrics of one analysis window",
+    FlickerWindow_fields,
+    5,
+};
+
+static PyObject* FlickerWindow_new(const FlickerResult* r) {
+    PyObject* item = PyStructSequence_New(FlickerWindowType);
+    if (!item) return NULL;
+    PyStructSequence_SET_ITEM(item, 0, PyLong_FromLongLong(r->timestamp));
+    PyStructSequence_SET_ITEM(item, 1, PyFloat_FromDouble(r->frequency));
+    PyStructSequence_SET_ITEM(item, 2, PyFloat_FromDouble(r->percent));
+    PyStructSequence_SET_ITEM(item, 3, PyFloat_FromDouble(r->index));
+    PyStructSequence_SET_ITEM(item, 4, PyFloat_FromDouble(r->mean));
+    if (PyErr_Occurred()) {
+        Py_DECREF(item);
+        return NULL;
+    }
+    return item;
+}
+
+typedef struct {
+    PyObject_HEAD
+    FlickerState state;
+} FlickerAnalyzerObject;
+
+static void FlickerAnalyzer_dealloc(FlickerAnalyzerObject* self) {
+    flicker_state_clear(&self->state);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int FlickerAnalyzer_init(FlickerAnalyzerObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"sample_rate_hz", "window", "min_hz", "max_hz", NULL};
+    double sample_rate = 0, min_hz = 0, max_hz = 0;
+    Py_ssize_t window = 256;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|ndd", kwlist, &sample_rate, &window, &min_hz, &max_hz)) {
+        return -1;
+    }
+
+    flicker_state_clear(&self->state);
+    return flicker_state_init(&self->state, sample_rate, window, min_hz, max_hz);
+}
+
+static PyObject* FlickerAnalyzer_push(FlickerAnalyzerObject* self, PyObject* args) {
+    long long timestamp;
+    double value;
+    if (check_initialized(self, self->state.window > 0) < 0) return NULL;
+    if (!PyArg_ParseTuple(args, "Ld", &timestamp, &value)) return NULL;
+
+    FlickerResult result;
+    if (flicker_push(&self->state, timestamp, value, &result)) {
+        return FlickerWindow_new(&result);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* FlickerAnalyzer_extend(FlickerAnalyzerObject* self, PyObject* args) {
+    PyObject *ts_obj, *values_obj;
+    if (check_initialized(self, self->state.window > 0) < 0) return NULL;
+    if (!PyArg_ParseTuple(args, "OO", &ts_obj, &values_obj)) return NULL;
+
+    ColumnArg ts, vals;
+    if (ColumnArg_load_samples(ts_obj, values_obj, &ts, &vals) < 0) return NULL;
+
+    Py_ssize_t capacity = ts.length / self->state.window + 1;
+    FlickerResult* results = PyMem_RawMalloc(capacity * sizeof(FlickerResult));
+    if (!results) {
+        ColumnArg_release(&ts);
+        ColumnArg_release(&vals);
+        return PyErr_NoMemory();
+    }
+
+    Py_ssize_t count = 0;
+    for (Py_ssize_t i = 0; i < ts.length; i++) {
+        count += flicker_push(&self->state, ((int64_t*)ts.data)[i], ((double*)vals.data)[i], &results[count]);
+    }
+    ColumnArg_release(&ts);
+    ColumnArg_release(&vals);
+
+    PyObject* list = PyList_New(count);
+    for (Py_ssize_t i = 0; list && i < count; i++) {
+        PyObject* item = FlickerWindow_new(&results[i]);
+        if (!item) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    PyMem_RawFree(results);
+    return list;
+}
+
+static PyObject* FlickerAnalyzer_get_resolution(FlickerAnalyzerObject* self, void* closure) {
+    return PyFloat_FromDouble(self->state.sample_rate / (double)self->state.window);
+}
+
+static PyGetSetDef FlickerAnalyzer_getset[] = {
+    {"resolution_hz", (getter)FlickerAnalyzer_get_resolution, NULL, "width of one frequency bin in Hz", NULL},
+    {NULL}
+};
+
+static PyMethodDef FlickerAnalyzer_methods[] = {
+    {"push", (PyCFunction)FlickerAnalyzer_push, METH_VARARGS, PyDoc_STR("Add one (timestamp_ns, value) sample; return a FlickerWindow when it completes a window, else None.")},
+    {"extend", (PyCFunction)FlickerAnalyzer_extend, METH_VARARGS, PyDoc_STR("Add columns of timestamps and values and return the list of completed FlickerWindows.")},
+    {NULL}
+};
+
+static PyTypeObject FlickerAnalyzerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.FlickerAnalyzer",
+    .tp_basicsize = sizeof(FlickerAnalyzerObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Windowed flicker frequency, percent flicker and flicker index of a fixed-rate stream",
+    .tp_methods = FlickerAnalyzer_methods,
+    .tp_getset = FlickerAnalyzer_getset,
+    .tp_dealloc = (destructor)FlickerAnalyzer_dealloc,
+    .tp_init = (initproc)FlickerAnalyzer_init,
+    .tp_new = PyType_GenericNew,
+};
+
+typedef enum {
+    CHANGE_STEP_UP,
+    CHANGE_STEP_DOWN,
+    CHANGE_STUCK,
+    CHANGE_DROPOUT,
+    CHANGE_SATURATION,
+} ChangeKind;
+
+static const char* change_kind_names[] = {"step_up", "step_down", "stuck", "dropout", "saturation"};
+
+typedef struct {
+    int64_t timestamp;
+    ChangeKind kind;
+    double value;
+    int64_t duration;
+} ChangeEvent;
+
+/* Two-sided Page-Hinkley test for level shifts plus simple checks for stuck
+ * readings, gaps in the stream and saturation. Each check reports once when
+ * its condition starts and re-arms when it clears. */
+typedef struct {
+    double threshold;
+    double delta;
+    Py_ssize_t stuck_samples;
+    int64_t max_gap;
+    double saturation;
+
+    Py_ssize_t n;
+    double mean;
+    double cum_up, min_up;
+    double cum_down, max_down;
+
+    int64_t last_timestamp;
+    double last_value;
+    int have_last;
+    Py_ssize_t run;
+    int64_t run_start;
+    int stuck;
+    int saturated;
+} ChangeState;
+
+static void change_reset_level(ChangeState* st, double value) {
+    st->n = 1;
+    st->mean = value;
+    st->cum_up = st->min_up = 0.0;
+    st->cum_down = st->max_down = 0.0;
+}
+
+/* Returns the number of events written to out (at most 4). */
+static int change_push(ChangeState* st, int64_t timestamp, double value, ChangeEvent* out) {
+    int count = 0;
+
+    if (st->have_last && st->max_gap > 0 && timestamp - st->last_timestamp > st->max_gap) {
+        out[count++] = (ChangeEvent){st->last_timestamp, CHANGE_DROPOUT, value, timestamp - st->last_timestamp};
+    }
+
+    if (isnan(value)) {
+        if (!st->have_last || !isnan(st->last_value)) {
+            out[count++] = (ChangeEvent){timestamp, CHANGE_DROPOUT, value, 0};
+        }
+        st->last_timestamp = timestamp;
+        st->last_value = value;
+        st->have_last = 1;
+        st->run = 0;
+        return count;
+    }
+
+    if (value >= st->saturation) {
+        if (!st->saturated) out[count++] = (ChangeEvent){timestamp, CHANGE_SATURATION, value, 0};
+        st->saturated = 1;
+    } else {
+        st->saturated = 0;
+    }
+
+    if (st->have_last && value == st->last_value) {
+        st->run++;
+    } else {
+        st->run = 1;
+        st->run_start = timestamp;
+        st->stuck = 0;
+    }
+    if (st->stuck_samples > 0 && st->run >= st->stuck_samples && !st->stuck) {
+        out[count++] = (ChangeEvent){timestamp, CHANGE_STUCK, value, timestamp - st->run_start};
+        st->stuck = 1;
+    }
+
+    st->last_timestamp = timestamp;
+    st->last_value = value;
+    st->have_last = 1;
+
+    if (st->n == 0) {
+        change_reset_level(st, value);
+        return count;
+    }
+
+    st->n++;
+    st->mean += (value - st->mean) / (double)st->n;
+    st->cum_up += value - st->mean - st->delta;
+    st->cum_down += value - st->mean + st->delta;
+    if (st->cum_up < st->min_up) st->min_up = st->cum_up;
+    if (st->cum_down > st->max_down) st->max_down = st->cum_down;
+
+    if (st->cum_up - st->min_up > st->threshold) {
+        out[count++] = (ChangeEvent){timestamp, CHANGE_STEP_UP, value, 0};
+        change_reset_level(st, value);
+    } else if (st->max_down - st->cum_down > st->threshold) {
+        out[count++] = (ChangeEvent){timestamp, CHANGE_STEP_DOWN, value, 0};
+        change_reset_level(st, value);
+    }
+    return count;
+}
+
+static PyTypeObject* SensorEventType;
+
+static PyStructSequence_Field SensorEvent_fields[] = {
+    {"timestamp_ns", "when the condition was detected (start of the gap for dropout)"},
+    {"kind", "step_up, step_down, stuck, dropout or saturation"},
+    {"value", "lux reading that triggered the event"},
+    {"duration_ns", "length of the gap for dropout, of the unchanged run for stuck, else 0"},
+    {NULL}
+};
+
+static PyStructSequence_Desc SensorEvent_desc = {
+    "_macals.SensorEvent",
+    "Event reported by a ChangeDetector",
+    SensorEvent_fields,
+    4,
+};
+
+static PyObject* SensorEvent_new(const ChangeEvent* e) {
+    PyObject* item = PyStructSequence_New(SensorEventType);
+    if (!item) return NULL;
+    PyStructSequence_SET_ITEM(item, 0, PyLong_FromLongLong(e->timestamp));
+    PyStructSequence_SET_ITEM(item, 1, PyUnicode_FromString(change_kind_names[e->kind]));
+    PyStructSequence_SET_ITEM(item, 2, PyFloat_FromDouble(e->value));
+    PyStructSequence_SET_ITEM(item, 3, PyLong_FromLongLong(e->duration));
+    if (PyErr_Occurred()) {
+        Py_DECREF(item);
+        return NULL;
+    }
+    return item;
+}
+
+static PyObject* SensorEvent_list(const ChangeEvent* events, Py_ssize_t count) {
+    PyObject* list = PyList_New(count);
+    if (!list) return NULL;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject* item = SensorEvent_new(&events[i]);
+        if (!item) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+typedef struct {
+    PyObject_HEAD
+    ChangeState state;
+} ChangeDetectorObject;
+
+static int ChangeDetector_init(ChangeDetectorObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"threshold", "delta", "stuck_samples", "max_gap_ns", "saturation", NULL};
+    double threshold = 0, delta = 0, saturation = INFINITY;
+    Py_ssize_t stuck_samples = 0;
+    long long max_gap = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|dnLd", kwlist, &threshold, &delta, &stuck_samples, &max_gap, &saturation)) {
+        return -1;
+    }
+    if (threshold <= 0) {
+        PyErr_SetString(PyExc_ValueError, "threshold must be positive.");
+        return -1;
+    }
+
+    memset(&self->state, 0, sizeof(self->state));
+    self->state.threshold = threshold;
+    self->state.delta = delta;
+    self->state.stuck_samples = stuck_samples;
+    self->state.max_gap = max_gap;
+    self->state.saturation = saturation;
+    return 0;
+}
+
+static PyObject* ChangeDetector_push(ChangeDetectorObject* self, PyObject* args) {
+    long long timestamp;
+    double value;
+    if (check_initialized(self, self->state.threshold > 0) < 0) return NULL;
+    if (!PyArg_ParseTuple(args, "Ld", &timestamp, &value)) return NULL;
+
+    ChangeEvent events[4];
+    int count = change_push(&self->state, timestamp, value, events);
+    return SensorEvent_list(events, count);
+}
+
+static PyObject* ChangeDetector_extend(ChangeDetectorObject* self, PyObject* args) {
+    PyObject *ts_obj, *values_obj;
+    if (check_initialized(self, self->state.threshold > 0) < 0) return NULL;
+    if (!PyArg_ParseTuple(args, "OO", &ts_obj, &values_obj)) return NULL;
+
+    ColumnArg ts, vals;
+    if (ColumnArg_load_samples(ts_obj, values_obj, &ts, &vals) < 0) return NULL;
+
+    ChangeEvent* events = NULL;
+    Py_ssize_t count = 0, capacity = 0;
+    int failed = 0;
+
+    for (Py_ssize_t i = 0; i < ts.length; i++) {
+        if (count + 4 > capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            ChangeEvent* grown = PyMem_RawRealloc(events, capacity * sizeof(ChangeEvent));
+            if (!grown) {
+                failed = 1;
+                break;
+            }
+            events = grown;
+        }
+        count += change_push(&self->state, ((int64_t*)ts.data)[i], ((double*)vals.data)[i], events + count);
+    }
+    ColumnArg_release(&ts);
+    ColumnArg_release(&vals);
+
+    PyObject* list = failed ? PyErr_NoMemory() : SensorEvent_list(events, count);
+    PyMem_RawFree(events);
+    return list;
+}
+
+static PyMethodDef ChangeDetector_methods[] = {
+    {"push", (PyCFunction)ChangeDetector_push, METH_VARARGS, PyDoc_STR("Add one (timestamp_ns, value) sample and return the list of SensorEvents it triggers.")},
+    {"extend", (PyCFunction)ChangeDetector_extend, METH_VARARGS, PyDoc_STR("Add columns of timestamps and values and return the list of SensorEvents they trigger.")},
+    {NULL}
+};
+
+static PyTypeObject ChangeDetectorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.ChangeDetector",
+    .tp_basicsize = sizeof(ChangeDetectorObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Online step, stuck, dropout and saturation detection over a lux stream",
+    .tp_methods = ChangeDetector_methods,
+    .tp_init = (initproc)ChangeDetector_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* Threshold rules with hysteresis and dwell time. Rules are evaluated in a
+ * space where they all fire on "x >= threshold" and re-arm on
+ * "x < threshold - hysteresis" (below-rules use x = -lux), and are kept
+ * sorted by both levels. A sample then only visits the rules whose levels
+ * lie between the previous and the current value, found by binary search,
+ * plus the rules waiting out their dwell time. */
+typedef enum {
+    RULE_ARMED,
+    RULE_PENDING,
+    RULE_FIRED,
+    RULE_REMOVED,
+} RuleStatus;
+
+typedef struct {
+    double threshold;
+    double rearm;
+    int64_t dwell;
+    int64_t pending_since;
+    int below;
+    int queued;
+    RuleStatus status;
+} Rule;
+
+typedef struct {
+    Py_ssize_t rule;
+    int64_t timestamp;
+    double value;
+    int active;
+} RuleMatch;
+
+typedef struct {
+    Py_ssize_t* by_threshold;
+    Py_ssize_t* by_rearm;
+    Py_ssize_t count;
+} RuleIndex;
+
+typedef struct {
+    Rule* rules;
+    Py_ssize_t count;
+    Py_ssize_t capacity;
+    RuleIndex index[2];
+    Py_ssize_t* pending;
+    Py_ssize_t pending_count;
+    double last;
+    int primed;
+    int dirty;
+} RuleEngine;
+
+static const Rule* rule_sort_base;
+
+static int rule_cmp_threshold(const void* a, const void* b) {
+    double x = rule_sort_base[*(const Py_ssize_t*)a].threshold;
+    double y = rule_sort_base[*(const Py_ssize_t*)b].threshold;
+    return (x > y) - (x < y);
+}
+
+static int rule_cmp_rearm(const void* a, const void* b) {
+    double x = rule_sort_base[*(const Py_ssize_t*)a].rearm;
+    double y = rule_sort_base[*(const Py_ssize_t*)b].rearm;
+    return (x > y) - (x < y);
+}
+
+static void rule_engine_clear(RuleEngine* eng) {
+    PyMem_RawFree(eng->rules);
+    PyMem_RawFree(eng->pending);
+    for (int d = 0; d < 2; d++) {
+        PyMem_RawFree(eng->index[d].by_threshold);
+        PyMem_RawFree(eng->index[d].by_rearm);
+    }
+    memset(eng, 0, sizeof(*eng));
+}
+
+/* Called with the GIL held, so the static sort base is safe. */
+static int rule_engine_rebuild(RuleEngine* eng) {
+    for (int d = 0; d < 2; d++) {
+        RuleIndex* idx = &eng->index[d];
+        PyMem_RawFree(idx->by_threshold);
+        PyMem_RawFree(idx->by_rearm);
+        idx->by_threshold = PyMem_RawMalloc((eng->count ? eng->count : 1) * sizeof(Py_ssize_t));
+        idx->by_rearm = PyMem_RawMalloc((eng->count ? eng->count : 1) * sizeof(Py_ssize_t));
+        idx->count = 0;
+        if (!idx->by_threshold || !idx->by_rearm) return -1;
+
+        for (Py_ssize_t i = 0; i < eng->count; i++) {
+            if (eng->rules[i].status != RULE_REMOVED && eng->rules[i].below == d) {
+                idx->by_threshold[idx->count] = i;
+                idx->by_rearm[idx->count] = i;
+                idx->count++;
+            }
+        }
+
+        rule_sort_base = eng->rules;
+        qsort(idx->by_threshold, idx->count, sizeof(Py_ssize_t), rule_cmp_threshold);
+        qsort(idx->by_rearm, idx->count, sizeof(Py_ssize_t), rule_cmp_rearm);
+    }
+
+    PyMem_RawFree(eng->pending);
+    eng->pending = PyMem_RawMalloc((eng->count ? eng->count : 1) * sizeof(Py_ssize_t));
+    if (!eng->pending) return -1;
+    eng->pending_count = 0;
+    for (Py_ssize_t i = 0; i < eng->count; i++) {
+        eng->rules[i].queued = 0;
+        if (eng->rules[i].status == RULE_PENDING) {
+            eng->rules[i].queued = 1;
+            eng->pending[eng->pending_count++] = i;
+        }
+    }
+
+    eng->primed = 0;
+    eng->dirty = 0;
+    return 0;
+}
+
+/* First position in order[0..n) whose level is > x (strict = 1) or >= x. */
+static Py_ssize_t rule_bisect(const Rule* rules, const Py_ssize_t* order, Py_ssize_t n, int by_rearm, double x, int strict) {
+    Py_ssize_t lo = 0, hi = n;
+    while (lo < hi) {
+        Py_ssize_t mid = lo + (hi - lo) / 2;
+        const Rule* r = &rules[order[mid]];
+        double level = by_rearm ? r->rearm : r->threshold;
+        if (level < x || (strict && level == x)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+typedef struct {
+    RuleMatch* items;
+    Py_ssize_t count;
+    Py_ssize_t capacity;
+} RuleMatches;
+
+static int rule_emit(RuleMatches* out, Py_ssize_t rule, int64_t timestamp, double value, int active) {
+    if (out->count == out->capacity) {
+        Py_ssize_t capacity = out->capacity ? out->capacity * 2 : 16;
+        RuleMatch* items = PyMem_RawRealloc(out->items, capacity * sizeof(RuleMatch));
+        if (!items) return -1;
+        out->items = items;
+        out->capacity = capacity;
+    }
+    out->items[out->count++] = (RuleMatch){rule, timestamp, value, active};
+    return 0;
+}
+
+static void rule_make_pending(RuleEngine* eng, Py_ssize_t i, int64_t timestamp) {
+    Rule* r = &eng->rules[i];
+    r->status = RULE_PENDING;
+    r->pending_since = timestamp;
+    if (!r->queued) {
+        r->queued = 1;
+        eng->pending[eng->pending_count++] = i;
+    }
+}
+
+/* A nan reading (a dropout) is skipped: it changes no rule, does not count
+ * towards a dwell time, and the next reading is compared with the last
+ * valid one. */
+static int rule_engine_push(RuleEngine* eng, int64_t timestamp, double lux, RuleMatches* out) {
+    if (isnan(lux)) return 0;
+
+    for (int d = 0; d < 2; d++) {
+        RuleIndex* idx = &eng->index[d];
+        double x = d ? -lux : lux;
+
+        if (!eng->primed) {
+            for (Py_ssize_t k = 0; k < idx->count; k++) {
+                Py_ssize_t i = idx->by_threshold[k];
+                Rule* r = &eng->rules[i];
+                if (r->status == RULE_ARMED && x >= r->threshold) {
+                    rule_make_pending(eng, i, timestamp);
+                } else if (r->status == RULE_PENDING && x < r->threshold) {
+                    r->status = RULE_ARMED;
+                } else if (r->status == RULE_FIRED && x < r->rearm) {
+                    r->status = RULE_ARMED;
+                    if (rule_emit(out, i, timestamp, lux, 0) < 0) return -1;
+                }
+            }
+            continue;
+        }
+
+        double prev = d ? -eng->last : eng->last;
+        if (x > prev) {
+            Py_ssize_t lo = rule_bisect(eng->rules, idx->by_threshold, idx->count, 0, prev, 1);
+            Py_ssize_t hi = rule_bisect(eng->rules, idx->by_threshold, idx->count, 0, x, 1);
+            for (Py_ssize_t k = lo; k < hi; k++) {
+                Py_ssize_t i = idx->by_threshold[k];
+                if (eng->rules[i].status == RULE_ARMED) rule_make_pending(eng, i, timestamp);
+            }
+        } else if (x < prev) {
+            Py_ssize_t lo = rule_bisect(eng->rules, idx->by_threshold, idx->count, 0, x, 1);
+            Py_ssize_t hi = rule_bisect(eng->rules, idx->by_threshold, idx->count, 0, prev, 1);
+            for (Py_ssize_t k = lo; k < hi; k++) {
+                Rule* r = &eng->rules[idx->by_threshold[k]];
+                if (r->status == RULE_PENDING) r->status = RULE_ARMED;
+            }
+
+            lo = rule_bisect(eng->rules, idx->by_rearm, idx->count, 1, x, 1);
+            hi = rule_bisect(eng->rules, idx->by_rearm, idx->count, 1, prev, 1);
+            for (Py_ssize_t k = lo; k < hi; k++) {
+                Py_ssize_t i = idx->by_rearm[k];
+                if (eng->rules[i].status == RULE_FIRED) {
+                    eng->rules[i].status = RULE_ARMED;
+                    if (rule_emit(out, i, timestamp, lux, 0) < 0) return -1;
+                }
+            }
+        }
+    }
+
+    eng->last = lux;
+    eng->primed = 1;
+
+    Py_ssize_t kept = 0;
+    for (Py_ssize_t k = 0; k < eng->pending_count; k++) {
+        Py_ssize_t i = eng->pending[k];
+        Rule* r = &eng->rules[i];
+        if (r->status == RULE_PENDING && timestamp - r->pending_since >= r->dwell) {
+            r->status = RULE_FIRED;
+            if (rule_emit(out, i, timestamp, lux, 1) < 0) return -1;
+        }
+        if (r->status == RULE_PENDING) {
+            eng->pending[kept++] = i;
+        } else {
+            r->queued = 0;
+        }
+    }
+    eng->pending_count = kept;
+    return 0;
+}
+
+static PyTypeObject* RuleEventType;
+
+static PyStructSequence_Field RuleEvent_fields[] = {
+    {"timestamp_ns", "timestamp of the sample that changed the rule"},
+    {"rule", "key the rule was added with"},
+    {"value", "lux value of that sample"},
+    {"active", "True when the rule fired, False when it re-armed"},
+    {NULL}
+};
+
+static PyStructSequence_Desc RuleEvent_desc = {
+    "_macals.RuleEvent",
+    "Rule transition reported by a RuleSet",
+    RuleEvent_fields,
+    4,
+};
+
+typedef struct {
+    PyObject_HEAD
+    RuleEngine engine;
+    PyObject* keys;
+} RuleSetObject;
+
+static void RuleSet_dealloc(RuleSetObject* self) {
+    rule_engine_clear(&self->engine);
+    Py_XDECREF(self->keys);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* RuleSet_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+    RuleSetObject* self = (RuleSetObject*)type->tp_alloc(type, 0);
+    if (self && !(self->keys = PyList_New(0))) Py_CLEAR(self);
+    return (PyObject*)self;
+}
+
+static int RuleSet_init(RuleSetObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist)) return -1;
+
+    PyObject* keys = PyList_New(0);
+    if (!keys) return -1;
+    rule_engine_clear(&self->engine);
+    Py_XSETREF(self->keys, keys);
+    return 0;
+}
+
+static PyObject* RuleSet_add(RuleSetObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"threshold", "hysteresis", "dwell_ns", "below", "key", NULL};
+    double threshold, hysteresis = 0.0;
+    long long dwell = 0;
+    int below = 0;
+    PyObject* key = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d|dLpO", kwlist, &threshold, &hysteresis, &dwell, &below, &key)) {
+        return NULL;
+    }
+    if (hysteresis < 0 || dwell < 0) {
+        PyErr_SetString(PyExc_ValueError, "hysteresis and dwell_ns must not be negative.");
+        return NULL;
+    }
+
+    RuleEngine* eng = &self->engine;
+    if (eng->count == eng->capacity) {
+        Py_ssize_t capacity = eng->capacity ? eng->capacity * 2 : 16;
+        Rule* rules = PyMem_RawRealloc(eng->rules, capacity * sizeof(Rule));
+        if (!rules) return PyErr_NoMemory();
+        eng->rules = rules;
+        eng->capacity = capacity;
+    }
+
+    Py_ssize_t id = eng->count;
+    PyObject* id_obj = PyLong_FromSsize_t(id);
+    if (!id_obj) return NULL;
+    if (PyList_Append(self->keys, key && key != Py_None ? key : id_obj) < 0) {
+        Py_DECREF(id_obj);
+        return NULL;
+    }
+
+    double level = below ? -threshold : threshold;
+    eng->rules[id] = (Rule){level, level - hysteresis, dwell, 0, below, 0, RULE_ARMED};
+    eng->count++;
+    eng->dirty = 1;
+    return id_obj;
+}
+
+static PyObject* RuleSet_remove(RuleSetObject* self, PyObject* args) {
+    Py_ssize_t id;
+    if (!PyArg_ParseTuple(args, "n", &id)) return NULL;
+
+    if (id < 0 || id >= self->engine.count || self->engine.rules[id].status == RULE_REMOVED) {
+        PyErr_SetString(PyExc_KeyError, "No such rule.");
+        return NULL;
+    }
+
+    self->engine.rules[id].status = RULE_REMOVED;
+    self->engine.dirty = 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject* RuleSet_matches(RuleSetObject* self, RuleMatches* matches) {
+    PyObject* list = PyList_New(matches->count);
+    for (Py_ssize_t i = 0; list && i < matches->count; i++) {
+        const RuleMatch* m = &matches->items[i];
+        PyObject* item = PyStructSequence_New(RuleEventType);
+        if (!item) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyObject* key = PyList_GET_ITEM(self->keys, m->rule);
+        Py_INCREF(key);
+        PyStructSequence_SET_ITEM(item, 0, PyLong_FromLongLong(m->timestamp));
+        PyStructSequence_SET_ITEM(item, 1, key);
+        PyStructSequence_SET_ITEM(item, 2, PyFloat_FromDouble(m->value));
+        PyStructSequence_SET_ITEM(item, 3, PyBool_FromLong(m->active));
+        PyList_SET_ITEM(list, i, item);
+    }
+    PyMem_RawFree(matches->items);
+    if (list && PyErr_Occurred()) Py_CLEAR(list);
+    return list;
+}
+
+static PyObject* RuleSet_evaluate(RuleSetObject* self, PyObject* args) {
+    PyObject *ts_obj, *values_obj;
+    if (!PyArg_ParseTuple(args, "OO", &ts_obj, &values_obj)) return NULL;
+
+    ColumnArg ts, vals;
+    if (ColumnArg_load_samples(ts_obj, values_obj, &ts, &vals) < 0) return NULL;
+
+    RuleMatches matches = {0};
+    int rc = self->engine.dirty ? rule_engine_rebuild(&self->engine) : 0;
+    for (Py_ssize_t i = 0; rc == 0 && i < ts.length; i++) {
+        rc = rule_engine_push(&self->engine, ((int64_t*)ts.data)[i], ((double*)vals.data)[i], &matches);
+    }
+    ColumnArg_release(&ts);
+    ColumnArg_release(&vals);
+
+    if (rc < 0) {
+        PyMem_RawFree(matches.items);
+        return PyErr_NoMemory();
+    }
+    return RuleSet_matches(self, &matches);
+}
+
+static PyObject* RuleSet_push(RuleSetObject* self, PyObject* args) {
+    long long timestamp;
+    double value;
+    if (!PyArg_ParseTuple(args, "Ld", &timestamp, &value)) return NULL;
+
+    RuleMatches matches = {0};
+    int rc = self->engine.dirty ? rule_engine_rebuild(&self->engine) : 0;
+    if (rc == 0) rc = rule_engine_push(&self->engine, timestamp, value, &matches);
+    if (rc < 0) {
+        PyMem_RawFree(matches.items);
+        return PyErr_NoMemory();
+    }
+    return RuleSet_matches(self, &matches);
+}
+
+static PyObject* RuleSet_get_active(RuleSetObject* self, void* closure) {
+    PyObject* list = PyList_New(0);
+    for (Py_ssize_t i = 0; list && i < self->engine.count; i++) {
+        if (self->engine.rules[i].status == RULE_FIRED && PyList_Append(list, PyList_GET_ITEM(self->keys, i)) < 0) {
+            Py_CLEAR(list);
+        }
+    }
+    return list;
+}
+
+static Py_ssize_t RuleSet_length(RuleSetObject* self) {
+    Py_ssize_t n = 0;
+    for (Py_ssize_t i = 0; i < self->engine.count; i++) {
+        n += self->engine.rules[i].status != RULE_REMOVED;
+    }
+    return n;
+}
+
+static PyGetSetDef RuleSet_getset[] = {
+    {"active", (getter)RuleSet_get_active, NULL, "keys of the rules that are currently fired", NULL},
+    {NULL}
+};
+
+static PyMethodDef RuleSet_methods[] = {
+    {"add", (PyCFunction)(void(*)(void))RuleSet_add, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Add a threshold rule and return its id.")},
+    {"remove", (PyCFunction)RuleSet_remove, METH_VARARGS, PyDoc_STR("Remove the rule with the given id.")},
+    {"push", (PyCFunction)RuleSet_push, METH_VARARGS, PyDoc_STR("Evaluate one (timestamp_ns, value) sample and return the list of RuleEvents.")},
+    {"evaluate", (PyCFunction)RuleSet_evaluate, METH_VARARGS, PyDoc_STR("Evaluate columns of timestamps and values and return all RuleEvents as one batch.")},
+    {NULL}
+};
+
+static PySequenceMethods RuleSet_as_sequence = {
+    .sq_length = (lenfunc)RuleSet_length,
+};
+
+static PyTypeObject RuleSetType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.RuleSet",
+    .tp_basicsize = sizeof(RuleSetObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Indexed set of threshold rules with hysteresis and dwell time",
+    .tp_methods = RuleSet_methods,
+    .tp_getset = RuleSet_getset,
+    .tp_as_sequence = &RuleSet_as_sequence,
+    .tp_dealloc = (destructor)RuleSet_dealloc,
+    .tp_init = (initproc)RuleSet_init,
+    .tp_new = RuleSet_new,
+};
+
+/* Auto-brightness controller. The curve maps log10(1 + lux) piecewise
+ * linearly to a brightness fraction, which is smoothed with a time-based EMA
+ * and written to the sink only when it moves by at least `hysteresis` steps.
+ * Latency is measured from the moment the lux value was sampled to the end
+ * of the write. A controller writing to a file can also be a Pipeline sink,
+ * fed on the sampling thread; lock guards its state against update() calls
+ * from Python. Callback sinks are only driven from threads holding the GIL. */
+typedef struct {
+    PyObject_HEAD
+    os_unfair_lock lock;
+    double* curve_x;
+    double* curve_y;
+    Py_ssize_t curve_len;
+    int64_t smoothing;
+    long hysteresis;
+    long max_brightness;
+    int fd;
+    int truncate;
+    PyObject* callback;
+    LightSensorObject* sensor;
+
+    double level;
+    int64_t level_timestamp;
+    int have_level;
+    long written;
+
+    int64_t last_latency;
+    int64_t max_latency;
+    double total_latency;
+    Py_ssize_t writes;
+} BacklightControllerObject;
+
+static int read_long_file(const char* path, long* out) {
+    char buf[32];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    *out = strtol(buf, NULL, 10);
+    return 0;
+}
+
+static int BacklightController_open_sink(BacklightControllerObject* self, PyObject* sink) {
+    if (PyCallable_Check(sink)) {
+        Py_INCREF(sink);
+        self->callback = sink;
+        return 0;
+    }
+
+    PyObject* path_bytes = NULL;
+    if (!PyUnicode_FSConverter(sink, &path_bytes)) return -1;
+
+    const char* path = PyBytes_AS_STRING(path_bytes);
+    char file[PATH_MAX];
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        snprintf(file, sizeof(file), "%s/max_brightness", path);
+        long max_brightness;
+        if (self->max_brightness <= 0 && read_long_file(file, &max_brightness) == 0) {
+            self->max_brightness = max_brightness;
+        }
+        snprintf(file, sizeof(file), "%s/brightness", path);
+    } else {
+        snprintf(file, sizeof(file), "%s", path);
+    }
+    Py_DECREF(path_bytes);
+
+    self->fd = open(file, O_WRONLY | O_CLOEXEC);
+    if (self->fd < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, file);
+        return -1;
+    }
+    self->truncate = fstat(self->fd, &st) == 0 && S_ISREG(st.st_mode);
+    return 0;
+}
+
+static void BacklightController_close(BacklightControllerObject* self) {
+    PyMem_RawFree(self->curve_x);
+    PyMem_RawFree(self->curve_y);
+    self->curve_x = self->curve_y = NULL;
+    self->curve_len = 0;
+    if (self->fd >= 0) close(self->fd);
+    self->fd = -1;
+    Py_CLEAR(self->callback);
+    Py_CLEAR(self->sensor);
+}
+
+static void BacklightController_dealloc(BacklightControllerObject* self) {
+    BacklightController_close(self);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* BacklightController_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+    BacklightControllerObject* self = (BacklightControllerObject*)type->tp_alloc(type, 0);
+    if (self) {
+        self->fd = -1;
+        self->written = -1;
+    }
+    return (PyObject*)self;
+}
+
+static int BacklightController_init(BacklightControllerObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"sink", "curve", "sensor", "smoothing_ns", "hysteresis", "max_brightness", NULL};
+    PyObject *sink, *curve, *sensor = Py_None;
+    long long smoothing = 0;
+    long hysteresis = 1, max_brightness = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|OLll", kwlist, &sink, &curve, &sensor, &smoothing, &hysteresis, &max_brightness)) {
+        return -1;
+    }
+    if (sensor != Py_None && !PyObject_TypeCheck(sensor, &LightSensorType)) {
+        PyErr_SetString(PyExc_TypeError, "sensor must be a LightSensor.");
+        return -1;
+    }
+    if (self->curve_len) {
+        PyErr_SetString(PyExc_RuntimeError, "BacklightController cannot be reinitialized.");
+        return -1;
+    }
+
+    BacklightController_close(self);
+    self->have_level = 0;
+    self->written = -1;
+    self->last_latency = self->max_latency = 0;
+    self->total_latency = 0.0;
+    self->writes = 0;
+    self->smoothing = smoothing;
+    self->hysteresis = hysteresis > 0 ? hysteresis : 1;
+    self->max_brightness = max_brightness;
+
+    PyObject* points = PySequence_Fast(curve, "curve must be a sequence of (lux, fraction) pairs.");
+    if (!points) return -1;
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(points);
+    self->curve_x = PyMem_RawMalloc((n ? n : 1) * sizeof(double));
+    self->curve_y = PyMem_RawMalloc((n ? n : 1) * sizeof(double));
+    if (!self->curve_x || !self->curve_y) {
+        Py_DECREF(points);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        double lux, fraction;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(points, i), "dd", &lux, &fraction)) {
+            Py_DECREF(points);
+            return -1;
+        }
+        if (lux < 0 || fraction < 0 || fraction > 1 || (i > 0 && log10(1.0 + lux) <= self->curve_x[i - 1])) {
+            Py_DECREF(points);
+            PyErr_SetString(PyExc_ValueError, "curve points need increasing lux >= 0 and fractions in [0, 1].");
+            return -1;
+        }
+        self->curve_x[i] = log10(1.0 + lux);
+        self->curve_y[i] = fraction;
+    }
+    Py_DECREF(points);
+
+    if (n == 0) {
+        PyErr_SetString(PyExc_ValueError, "curve needs at least one point.");
+        return -1;
+    }
+
+    if (BacklightController_open_sink(self, sink) < 0) return -1;
+    if (self->max_brightness <= 0) self->max_brightness = 100;
+
+    if (sensor != Py_None) {
+        Py_INCREF(sensor);
+        self->sensor = (LightSensorObject*)sensor;
+    }
+    self->curve_len = n;
+    return 0;
+}
+
+static double backlight_curve(const BacklightControllerObject* self, double lux) {
+    double x = log10(1.0 + (lux > 0 ? lux : 0));
+    const double* xs = self->curve_x;
+    const double* ys = self->curve_y;
+    Py_ssize_t n = self->curve_len;
+
+    if (x <= xs[0]) return ys[0];
+    if (x >= xs[n - 1]) return ys[n - 1];
+
+    Py_ssize_t lo = 0, hi = n - 1;
+    while (hi - lo > 1) {
+        Py_ssize_t mid = (lo + hi) / 2;
+        if (xs[mid] <= x) lo = mid; else hi = mid;
+    }
+    return ys[lo] + (ys[hi] - ys[lo]) * (x - xs[lo]) / (xs[hi] - xs[lo]);
+}
+
+/* Smooths the curve value for a reading. Returns the brightness to write, or
+ * -1 when the hysteresis keeps the sink where it is. */
+static long backlight_target(BacklightControllerObject* self, double lux, int64_t timestamp) {
+    double target = backlight_curve(self, lux);
+
+    if (!self->have_level || self->smoothing <= 0) {
+        self->level = target;
+    } else if (timestamp > self->level_timestamp) {
+        double alpha = 1.0 - exp(-(double)(timestamp - self->level_timestamp) / (double)self->smoothing);
+        self->level += alpha * (target - self->level);
+    }
+    self->have_level = 1;
+    self->level_timestamp = timestamp;
+
+    long brightness = lround(self->level * (double)self->max_brightness);
+    if (self->written >= 0 && labs(brightness - self->written) < self->hysteresis) return -1;
+    return brightness;
+}
+
+static void backlight_written(BacklightControllerObject* self, long brightness, int64_t timestamp) {
+    self->written = brightness;
+    int64_t latency = monotonic_ns() - timestamp;
+    self->last_latency = latency;
+    if (latency > self->max_latency) self->max_latency = latency;
+    self->total_latency += (double)latency;
+    self->writes++;
+}
+
+/* Applies a reading to a file sink; safe without the GIL. Returns the
+ * brightness now on the sink, or -1 with errno set when the write failed. */
+static long backlight_feed(BacklightControllerObject* self, double lux, int64_t timestamp) {
+    os_unfair_lock_lock(&self->lock);
+    long brightness = backlight_target(self, lux, timestamp);
+    if (brightness < 0) {
+        brightness = self->written;
+    } else {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "%ld\n", brightness);
+        if (pwrite(self->fd, buf, n, 0) != n || (self->truncate && ftruncate(self->fd, n) < 0)) {
+            brightness = -1;
+        } else {
+            backlight_written(self, brightness, timestamp);
+        }
+    }
+    os_unfair_lock_unlock(&self->lock);
+    return brightness;
+}
+
+/* Returns the brightness now on the sink, or -1 with an exception set. */
+static long backlight_update(BacklightControllerObject* self, double lux, int64_t timestamp) {
+    if (!self->callback) {
+        long brightness = backlight_feed(self, lux, timestamp);
+        if (brightness < 0) PyErr_SetFromErrno(PyExc_OSError);
+        return brightness;
+    }
+
+    long brightness = backlight_target(self, lux, timestamp);
+    if (brightness < 0) return self->written;
+    PyObject* result = PyObject_CallFunction(self->callback, "l", brightness);
+    if (!result) return -1;
+    Py_DECREF(result);
+    backlight_written(self, brightness, timestamp);
+    return brightness;
+}
+
+static PyObject* BacklightController_update(BacklightControllerObject* self, PyObject* args) {
+    double lux;
+    long long timestamp = 0;
+    if (!PyArg_ParseTuple(args, "d|L", &lux, &timestamp)) return NULL;
+    if (check_initialized(self, self->curve_len > 0) < 0) return NULL;
+
+    long brightness = backlight_update(self, lux, timestamp ? timestamp : monotonic_ns());
+    return brightness < 0 ? NULL : PyLong_FromLong(brightness);
+}
+
+static PyObject* BacklightController_step(BacklightControllerObject* self, PyObject* Py_UNUSED(ignored)) {
+    if (check_initialized(self, self->curve_len > 0) < 0) return NULL;
+    if (!self->sensor) {
+        PyErr_SetString(PyExc_RuntimeError, "BacklightController has no sensor.");
+        return NULL;
+    }
+
+    LightSensorObject* sensor = self->sensor;
+    int64_t timestamp;
+    float lux;
+    LuxStatus status;
+    Py_INCREF(sensor);
+    Py_BEGIN_ALLOW_THREADS
+    status = LightSensor_read(sensor, &lux, &timestamp);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(sensor);
+    if (status != LUX_OK) {
+        PyErr_SetString(PyExc_RuntimeError, lux_status_messages[status]);
+        return NULL;
+    }
+
+    long brightness = backlight_update(self, lux, timestamp);
+    return brightness < 0 ? NULL : PyLong_FromLong(brightness);
+}
+
+static PyObject* BacklightController_get_brightness(BacklightControllerObject* self, void* closure) {
+    if (self->written < 0) Py_RETURN_NONE;
+    return PyLong_FromLong(self->written);
+}
+
+static PyObject* BacklightController_get_last_latency(BacklightControllerObject* self, void* closure) {
+    return PyLong_FromLongLong(self->last_latency);
+}
+
+static PyObject* BacklightController_get_max_latency(BacklightControllerObject* self, void* closure) {
+    return PyLong_FromLongLong(self->max_latency);
+}
+
+static PyObject* BacklightController_get_mean_latency(BacklightControllerObject* self, void* closure) {
+    return PyFloat_FromDouble(self->writes ? self->total_latency / (double)self->writes : 0.0);
+}
+
+static PyObject* BacklightController_get_writes(BacklightControllerObject* self, void* closure) {
+    return PyLong_FromSsize_t(self->writes);
+}
+
+static PyGetSetDef BacklightController_getset[] = {
+    {"brightness", (getter)BacklightController_get_brightness, NULL, "brightness last written to the sink, or None", NULL},
+    {"last_latency_ns", (getter)BacklightController_get_last_latency, NULL, "sample-to-write latency of the last write", NULL},
+    {"max_latency_ns", (getter)BacklightController_get_max_latency, NULL, "largest sample-to-write latency seen", NULL},
+    {"mean_latency_ns", (getter)BacklightController_get_mean_latency, NULL, "mean sample-to-write latency", NULL},
+    {"writes", (getter)BacklightController_get_writes, NULL, "number of writes to the sink", NULL},
+    {NULL}
+};
+
+static PyMethodDef BacklightController_methods[] = {
+    {"update", (PyCFunction)BacklightController_update, METH_VARARGS, PyDoc_STR("Apply a lux value sampled at timestamp_ns (default now) and return the sink brightness.")},
+    {"step", (PyCFunction)BacklightController_step, METH_NOARGS, PyDoc_STR("Read the sensor, apply the reading and return the sink brightness.")},
+    {NULL}
+};
+
+static PyTypeObject BacklightControllerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.BacklightController",
+    .tp_basicsize = sizeof(BacklightControllerObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Closed-loop mapping of lux to backlight brightness",
+    .tp_methods = BacklightController_methods,
+    .tp_getset = BacklightController_getset,
+    .tp_dealloc = (destructor)BacklightController_dealloc,
+    .tp_init = (initproc)BacklightController_init,
+    .tp_new = BacklightController_new,
+};
+
+/* ReplaySource: a recorded trace a Scheduler or SensorGroup plays back in
+ * place of a sensor, one value per read. */
+
+typedef struct {
+    PyObject_HEAD
+    os_unfair_lock lock;
+    double* values;
+    Py_ssize_t length;
+    Py_ssize_t position;
+    int loop;
+} ReplaySourceObject;
+
+/* Safe without the GIL. Returns 0 once a source that does not loop has run
+ * out. */
+static int ReplaySource_next(ReplaySourceObject* self, double* value) {
+    int ok = 0;
+    os_unfair_lock_lock(&self->lock);
+    if (self->position == self->length && self->loop) self->position = 0;
+    if (self->position < self->length) {
+        *value = self->values[self->position++];
+        ok = 1;
+    }
+    os_unfair_lock_unlock(&self->lock);
+    return ok;
+}
+
+static void ReplaySource_dealloc(ReplaySourceObject* self) {
+    PyMem_RawFree(self->values);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int ReplaySource_init(ReplaySourceObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"values", "loop", NULL};
+    PyObject* values_obj;
+    int loop = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|p", kwlist, &values_obj, &loop)) return -1;
+
+    ColumnArg vals;
+    if (ColumnArg_load(values_obj, 'd', &vals) < 0) return -1;
+    if (vals.length == 0) {
+        ColumnArg_release(&vals);
+        PyErr_SetString(PyExc_ValueError, "values must not be empty.");
+        return -1;
+    }
+    double* values = PyMem_RawMalloc(vals.length * sizeof(double));
+    if (!values) {
+        ColumnArg_release(&vals);
+        PyErr_NoMemory();
+        return -1;
+    }
+    memcpy(values, vals.data, vals.length * sizeof(double));
+    Py_ssize_t length = vals.length;
+    ColumnArg_release(&vals);
+
+    os_unfair_lock_lock(&self->lock);
+    double* old = self->values;
+    self->values = values;
+    self->length = length;
+    self->position = 0;
+    self->loop = loop;
+    os_unfair_lock_unlock(&self->lock);
+    PyMem_RawFree(old);
+    return 0;
+}
+
+static PyObject* ReplaySource_rewind(ReplaySourceObject* self, PyObject* Py_UNUSED(ignored)) {
+    os_unfair_lock_lock(&self->lock);
+    self->position = 0;
+    os_unfair_lock_unlock(&self->lock);
+    Py_RETURN_NONE;
+}
+
+static PyObject* ReplaySource_get_position(ReplaySourceObject* self, void* closure) {
+    os_unfair_lock_lock(&self->lock);
+    Py_ssize_t position = self->position;
+    os_unfair_lock_unlock(&self->lock);
+    return PyLong_FromSsize_t(position);
+}
+
+static Py_ssize_t ReplaySource_length(ReplaySourceObject* self) {
+    return self->length;
+}
+
+static PyGetSetDef ReplaySource_getset[] = {
+    {"position", (getter)ReplaySource_get_position, NULL, "index of the value the next scheduled read returns", NULL},
+    {NULL}
+};
+
+static PyMethodDef ReplaySource_methods[] = {
+    {"rewind", (PyCFunction)ReplaySource_rewind, METH_NOARGS, PyDoc_STR("Start playback again from the first value.")},
+    {NULL}
+};
+
+static PySequenceMethods ReplaySource_as_sequence = {
+    .sq_length = (lenfunc)ReplaySource_length,
+};
+
+static PyTypeObject ReplaySourceType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.ReplaySource",
+    .tp_basicsize = sizeof(ReplaySourceObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Recorded lux values a Scheduler feeds into a Pipeline in place of a sensor",
+    .tp_methods = ReplaySource_methods,
+    .tp_getset = ReplaySource_getset,
+    .tp_as_sequence = &ReplaySource_as_sequence,
+    .tp_dealloc = (destructor)ReplaySource_dealloc,
+    .tp_init = (initproc)ReplaySource_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* Reads a fixed set of sensors per call: one native call and one GIL release
+ * per cycle instead of one Python method call per sensor, with the IOKit
+ * property reads of larger groups spread over the dispatch thread pool. */
+typedef struct {
+    PyObject* source;
+    int replay;
+    int64_t timestamp;
+    double lux;
+    LuxStatus status;
+} GroupRead;
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* sensors;
+} SensorGroupObject;
+
+#define GROUP_PARALLEL_MIN 4
+
+static void group_read_one(void* context, size_t i) {
+    GroupRead* read = &((GroupRead*)context)[i];
+    if (read->replay) {
+        read->timestamp = monotonic_ns();
+        read->status = ReplaySource_next((ReplaySourceObject*)read->source, &read->lux) ? LUX_OK : LUX_NO_SERVICE;
+        return;
+    }
+    float lux;
+    read->status = LightSensor_read((LightSensorObject*)read->source, &lux, &read->timestamp);
+    read->lux = lux;
+}
+
+static void SensorGroup_dealloc(SensorGroupObject* self) {
+    Py_XDECREF(self->sensors);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int SensorGroup_init(SensorGroupObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"sensors", NULL};
+    PyObject* sensors;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &sensors)) return -1;
+
+    PyObject* tuple = PySequence_Tuple(sensors);
+    if (!tuple) return -1;
+
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(tuple); i++) {
+        PyObject* member = PyTuple_GET_ITEM(tuple, i);
+        if (!PyObject_TypeCheck(member, &LightSensorType) && !PyObject_TypeCheck(member, &ReplaySourceType)) {
+            Py_DECREF(tuple);
+            PyErr_SetString(PyExc_TypeError, "SensorGroup expects LightSensor or ReplaySource objects.");
+            return -1;
+        }
+    }
+
+    Py_XSETREF(self->sensors, tuple);
+    return 0;
+}
+
+/* Reads every sensor, records the readings like get_current_lux() does and
+ * returns a buffer of *count reads for the caller to free, or NULL with an
+ * exception naming the first sensor that failed. Each call reads into its
+ * own buffer and holds the sensor tuple, so concurrent calls and __init__
+ * during a read cannot pull either from under the workers. */
+static GroupRead* SensorGroup_read_all(SensorGroupObject* self, Py_ssize_t* count) {
+    if (check_initialized(self, self->sensors != NULL) < 0) return NULL;
+
+    PyObject* sensors = self->sensors;
+    Py_INCREF(sensors);
+    Py_ssize_t n = PyTuple_GET_SIZE(sensors);
+    GroupRead* reads = PyMem_RawMalloc((n ? n : 1) * sizeof(GroupRead));
+    if (!reads) {
+        Py_DECREF(sensors);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        reads[i].source = PyTuple_GET_ITEM(sensors, i);
+        reads[i].replay = PyObject_TypeCheck(reads[i].source, &ReplaySourceType);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (n >= GROUP_PARALLEL_MIN) {
+        dispatch_apply_f(n, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), reads, group_read_one);
+    } else {
+        for (Py_ssize_t i = 0; i < n; i++) group_read_one(reads, i);
+    }
+    Py_END_ALLOW_THREADS
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        if (reads[i].status == LUX_OK) continue;
+        if (reads[i].replay) {
+            PyErr_Format(PyExc_RuntimeError, "ReplaySource at index %zd has run out of values.", i);
+        } else {
+            PyErr_Format(PyExc_RuntimeError, "%s: %s", ((LightSensorObject*)reads[i].source)->service_name, lux_status_messages[reads[i].status]);
+        }
+        PyMem_RawFree(reads);
+        reads = NULL;
+        break;
+    }
+    Py_DECREF(sensors);
+    *count = n;
+    return reads;
+}
+
+static PyObject* SensorGroup_read(SensorGroupObject* self, PyObject* Py_UNUSED(ignored)) {
+    Py_ssize_t count;
+    GroupRead* reads = SensorGroup_read_all(self, &count);
+    if (!reads) return NULL;
+
+    PyObject* result = PyTuple_New(count);
+    for (Py_ssize_t i = 0; result && i < count; i++) {
+        PyObject* value = PyFloat_FromDouble(reads[i].lux);
+        if (!value) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyTuple_SET_ITEM(result, i, value);
+    }
+    PyMem_RawFree(reads);
+    return result;
+}
+
+static PyObject* SensorGroup_snapshot(SensorGroupObject* self, PyObject* Py_UNUSED(ignored)) {
+    Py_ssize_t count;
+    GroupRead* reads = SensorGroup_read_all(self, &count);
+    if (!reads) return NULL;
+
+    SampleBuf out = {0};
+    if (SampleBuf_reserve(&out, count ? count : 1) < 0) {
+        PyMem_RawFree(reads);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        SampleBuf_append(&out, reads[i].timestamp, reads[i].lux);
+    }
+    PyMem_RawFree(reads);
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* SensorGroup_get_sensors(SensorGroupObject* self, void* closure) {
+    if (!self->sensors) return PyTuple_New(0);
+    Py_INCREF(self->sensors);
+    return self->sensors;
+}
+
+static Py_ssize_t SensorGroup_length(SensorGroupObject* self) {
+    return self->sensors ? PyTuple_GET_SIZE(self->sensors) : 0;
+}
+
+static PyGetSetDef SensorGroup_getset[] = {
+    {"sensors", (getter)SensorGroup_get_sensors, NULL, "tuple of the sensors in the group", NULL},
+    {NULL}
+};
+
+static PyMethodDef SensorGroup_methods[] = {
+    {"read", (PyCFunction)SensorGroup_read, METH_NOARGS, PyDoc_STR("Read every sensor and return a tuple of lux values in group order.")},
+    {"snapshot", (PyCFunction)SensorGroup_snapshot, METH_NOARGS, PyDoc_STR("Read every sensor and return the readings as a SampleBatch in group order.")},
+    {NULL}
+};
+
+static PySequenceMethods SensorGroup_as_sequence = {
+    .sq_length = (lenfunc)SensorGroup_length,
+};
+
+static PyTypeObject SensorGroupType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.SensorGroup",
+    .tp_basicsize = sizeof(SensorGroupObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Fixed set of sensors read together in one native call",
+    .tp_methods = SensorGroup_methods,
+    .tp_getset = SensorGroup_getset,
+    .tp_as_sequence = &SensorGroup_as_sequence,
+    .tp_dealloc = (destructor)SensorGroup_dealloc,
+    .tp_init = (initproc)SensorGroup_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* Uplink: store-and-forward shipping of readings to a collector. Readings
+ * are collected into batches that a sender thread compresses and sends over
+ * TCP or a Unix socket, one frame at a time, each acknowledged by the
+ * collector echoing its sequence number. While the collector is unreachable
+ * frames go to a spool directory capped at spool_max_bytes, oldest dropped
+ * first, and are resent in order once it is back.
+ *
+ * Frame: a 32-byte header followed by a zlib stream. All integers are
+ * little-endian.
+ *   0  magic "MLUX"    4  version (u16) = 1, flags (u16) = 0
+ *   8  sequence (u64) 16  sample count (u32)
+ *  20  raw length (u32) 24  payload length (u32) 28  crc32 of payload (u32)
+ * The raw data is count int64 timestamp deltas (the first is absolute)
+ * followed by count float64 values. The ack is the sequence as a u64.
+ *
+ * Sequences keep increasing across restarts: they start no lower than the
+ * wall-clock time in nanoseconds, and an Uplink with a spool also records a
+ * reserved upper bound in spool_dir/seq before sending past the last one.
+ * The spool directory is locked for the Uplink's lifetime. */
+
+#define UPLINK_HEADER 32
+#define UPLINK_MEMORY_FRAMES 8
+#define UPLINK_MIN_BACKOFF_NS 500000000LL
+#define UPLINK_MAX_BACKOFF_NS 30000000000LL
+#define UPLINK_SEQ_RESERVE 4096
+
+typedef struct UplinkBatch {
+    struct UplinkBatch* next;
+    uint64_t seq;
+    SampleBuf buf;
+} UplinkBatch;
+
+typedef struct UplinkFrame {
+    struct UplinkFrame* next;
+    uint64_t seq;
+    uint32_t count;
+    size_t length;
+    unsigned char data[];
+} UplinkFrame;
+
+typedef struct {
+    uint64_t seq;
+    uint32_t count;
+    int64_t bytes;
+} SpoolEntry;
+
+typedef struct {
+    PyObject_HEAD
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int initialized;
+    int running;
+    int started;
+
+    char address[PATH_MAX];
+    char spool_dir[PATH_MAX - 32];
+    int64_t spool_max;
+    int spool_lock;
+    Py_ssize_t batch_size;
+    int64_t max_delay;
+    int64_t timeout;
+    int level;
+
+    SampleBuf batch;
+    int64_t batch_started;
+    UplinkBatch* sealed;
+    UplinkBatch** sealed_tail;
+    uint64_t next_seq;
+
+    /* Owned by the sender thread. */
+    int fd;
+    UplinkFrame* frames;
+    Py_ssize_t frame_count;
+    SpoolEntry* spool;
+    Py_ssize_t spool_count;
+    Py_ssize_t spool_capacity;
+    uint64_t seq_reserved;
+
+    /* Guarded by lock. */
+    int connected;
+    uint64_t queued;
+    uint64_t sent;
+    uint64_t spooled;
+    uint64_t dropped;
+} UplinkObject;
+
+static void put_le(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out[i] = (unsigned char)(value >> (8 * i));
+}
+
+static uint64_t get_le(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= (uint64_t)in[i] << (8 * i);
+    return value;
+}
+
+/* Seals the open batch with lock held. */
+static int uplink_seal(UplinkObject* u) {
+    UplinkBatch* b = PyMem_RawMalloc(sizeof(UplinkBatch));
+    if (!b) return -1;
+    b->next = NULL;
+    b->seq = u->next_seq++;
+    b->buf = u->batch;
+    memset(&u->batch, 0, sizeof(u->batch));
+    *u->sealed_tail = b;
+    u->sealed_tail = &b->next;
+    return 0;
+}
+
+/* Adds a reading without the GIL. Returns -1 when out of memory. */
+static int uplink_append(UplinkObject* u, int64_t timestamp, double value) {
+    int rc = 0;
+    pthread_mutex_lock(&u->lock);
+    if (!u->running) {
+        u->dropped++;
+    } else {
+        if (!u->batch.length) u->batch_started = monotonic_ns();
+        rc = SampleBuf_append(&u->batch, timestamp, value);
+        if (rc == 0) u->queued++;
+        if (rc == 0 && u->batch.length >= u->batch_size && uplink_seal(u) == 0) pthread_cond_signal(&u->cond);
+    }
+    pthread_mutex_unlock(&u->lock);
+    return rc;
+}
+
+static void uplink_count(UplinkObject* u, uint64_t* counter, uint64_t delta, uint64_t queued) {
+    pthread_mutex_lock(&u->lock);
+    *counter += delta;
+    u->queued -= queued;
+    pthread_mutex_unlock(&u->lock);
+}
+
+static UplinkFrame* uplink_compress(const UplinkObject* u, const UplinkBatch* b) {
+    Py_ssize_t n = b->buf.length;
+    uLong raw_length = (uLong)n * 16;
+    unsigned char* raw = PyMem_RawMalloc(raw_length ? raw_length : 1);
+    if (!raw) return NULL;
+
+    int64_t previous = 0;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        put_le(raw + 8 * i, (uint64_t)(b->buf.timestamps[i] - previous), 8);
+        previous = b->buf.timestamps[i];
+    }
+    memcpy(raw + 8 * n, b->buf.values, 8 * n);
+
+    uLongf payload = compressBound(raw_length);
+    UplinkFrame* f = PyMem_RawMalloc(sizeof(UplinkFrame) + UPLINK_HEADER + payload);
+    if (f && compress2(f->data + UPLINK_HEADER, &payload, raw, raw_length, u->level) != Z_OK) {
+        PyMem_RawFree(f);
+        f = NULL;
+    }
+    PyMem_RawFree(raw);
+    if (!f) return NULL;
+
+    f->next = NULL;
+    f->seq = b->seq;
+    f->count = (uint32_t)n;
+    f->length = UPLINK_HEADER + payload;
+    memcpy(f->data, "MLUX", 4);
+    put_le(f->data + 4, 1, 2);
+    put_le(f->data + 6, 0, 2);
+    put_le(f->data + 8, f->seq, 8);
+    put_le(f->data + 16, f->count, 4);
+    put_le(f->data + 20, raw_length, 4);
+    put_le(f->data + 24, payload, 4);
+    put_le(f->data + 28, crc32(0, f->data + UPLINK_HEADER, (uInt)payload), 4);
+    return f;
+}
+
+static void uplink_spool_path(const UplinkObject* u, uint64_t seq, const char* suffix, char* out) {
+    snprintf(out, PATH_MAX, "%s/%020llu.%s", u->spool_dir, (unsigned long long)seq, suffix);
+}
+
+static void uplink_spool_pop(UplinkObject* u, int delivered) {
+    SpoolEntry entry = u->spool[0];
+    char path[PATH_MAX];
+    uplink_spool_path(u, entry.seq, "mlux", path);
+    unlink(path);
+    memmove(u->spool, u->spool + 1, (u->spool_count - 1) * sizeof(SpoolEntry));
+    u->spool_count--;
+
+    pthread_mutex_lock(&u->lock);
+    u->spooled -= entry.count;
+    if (delivered) {
+        u->sent += entry.count;
+    } else {
+        u->dropped += entry.count;
+    }
+    pthread_mutex_unlock(&u->lock);
+}
+
+/* Moves the oldest in-memory frame to the spool, or drops it when there is
+ * no spool or it cannot be written. */
+static void uplink_offload(UplinkObject* u) {
+    UplinkFrame* f = u->frames;
+    u->frames = f->next;
+    u->frame_count--;
+
+    int64_t spool_bytes = 0;
+    for (Py_ssize_t i = 0; i < u->spool_count; i++) spool_bytes += u->spool[i].bytes;
+
+    int kept = 0;
+    if (u->spool_dir[0] && (int64_t)f->length <= u->spool_max) {
+        while (u->spool_count && spool_bytes + (int64_t)f->length > u->spool_max) {
+            spool_bytes -= u->spool[0].bytes;
+            uplink_spool_pop(u, 0);
+        }
+        if (u->spool_count == u->spool_capacity) {
+            Py_ssize_t capacity = u->spool_capacity ? u->spool_capacity * 2 : 64;
+            SpoolEntry* spool = PyMem_RawRealloc(u->spool, capacity * sizeof(SpoolEntry));
+            if (spool) {
+                u->spool = spool;
+                u->spool_capacity = capacity;
+            }
+        }
+
+        char tmp[PATH_MAX], path[PATH_MAX];
+        uplink_spool_path(u, f->seq, "tmp", tmp);
+        uplink_spool_path(u, f->seq, "mlux", path);
+        int fd = u->spool_count < u->spool_capacity ? open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+        if (fd >= 0) {
+            kept = write(fd, f->data, f->length) == (ssize_t)f->length;
+            kept = close(fd) == 0 && kept && rename(tmp, path) == 0;
+            if (!kept) unlink(tmp);
+        }
+        if (kept) u->spool[u->spool_count++] = (SpoolEntry){f->seq, f->count, (int64_t)f->length};
+    }
+
+    uplink_count(u, kept ? &u->spooled : &u->dropped, f->count, f->count);
+    PyMem_RawFree(f);
+}
+
+static uint64_t uplink_load_seq(const UplinkObject* u) {
+    char path[PATH_MAX], text[32];
+    snprintf(path, sizeof(path), "%s/seq", u->spool_dir);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    text[n > 0 ? n : 0] = '\0';
+    return strtoull(text, NULL, 10);
+}
+
+/* Records that sequences below seq + UPLINK_SEQ_RESERVE may be in use. */
+static void uplink_reserve_seq(UplinkObject* u, uint64_t seq) {
+    char tmp[PATH_MAX], path[PATH_MAX], text[32];
+    snprintf(tmp, sizeof(tmp), "%s/seq.tmp", u->spool_dir);
+    snprintf(path, sizeof(path), "%s/seq", u->spool_dir);
+    int length = snprintf(text, sizeof(text), "%llu\n", (unsigned long long)(seq + UPLINK_SEQ_RESERVE));
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    int ok = write(fd, text, length) == length;
+    ok = close(fd) == 0 && ok && rename(tmp, path) == 0;
+    if (ok) {
+        u->seq_reserved = seq + UPLINK_SEQ_RESERVE;
+    } else {
+        unlink(tmp);
+    }
+}
+
+/* Picks up frames spooled by an earlier run, oldest first. */
+static int spool_entry_compare(const void* a, const void* b) {
+    uint64_t x = ((const SpoolEntry*)a)->seq, y = ((const SpoolEntry*)b)->seq;
+    return x < y ? -1 : x > y;
+}
+
+static void uplink_spool_scan(UplinkObject* u) {
+    DIR* dir = opendir(u->spool_dir);
+    if (!dir) return;
+
+    struct dirent* ent;
+    while ((ent = readdir(dir))) {
+        char* end;
+        unsigned long long seq = strtoull(ent->d_name, &end, 10);
+        if (end == ent->d_name || strcmp(end, ".mlux") != 0) continue;
+
+        char path[PATH_MAX];
+        unsigned char header[UPLINK_HEADER];
+        struct stat st;
+        uplink_spool_path(u, seq, "mlux", path);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        int ok = read(fd, header, sizeof(header)) == (ssize_t)sizeof(header) && memcmp(header, "MLUX", 4) == 0 && fstat(fd, &st) == 0;
+        close(fd);
+        if (!ok) continue;
+
+        if (u->spool_count == u->spool_capacity) {
+            Py_ssize_t capacity = u->spool_capacity ? u->spool_capacity * 2 : 64;
+            SpoolEntry* spool = PyMem_RawRealloc(u->spool, capacity * sizeof(SpoolEntry));
+            if (!spool) break;
+            u->spool = spool;
+            u->spool_capacity = capacity;
+        }
+        u->spool[u->spool_count++] = (SpoolEntry){seq, (uint32_t)get_le(header + 16, 4), (int64_t)st.st_size};
+        u->spooled += get_le(header + 16, 4);
+        if (seq >= u->next_seq) u->next_seq = seq + 1;
+    }
+    closedir(dir);
+    qsort(u->spool, u->spool_count, sizeof(SpoolEntry), spool_entry_compare);
+}
+
+static int uplink_connect(const UplinkObject* u) {
+    struct addrinfo* addresses = NULL;
+    struct sockaddr_un local = {.sun_family = AF_UNIX};
+    struct addrinfo unix_address = {.ai_family = AF_UNIX, .ai_socktype = SOCK_STREAM, .ai_addr = (struct sockaddr*)&local, .ai_addrlen = sizeof(local)};
+
+    if (strncmp(u->address, "unix://", 7) == 0) {
+        snprintf(local.sun_path, sizeof(local.sun_path), "%s", u->address + 7);
+    } else {
+        char host[256];
+        const char* port = strrchr(u->address + 6, ':');
+        if (!port) return -1;
+        snprintf(host, sizeof(host), "%.*s", (int)(port - (u->address + 6)), u->address + 6);
+        if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+            memmove(host, host + 1, strlen(host) - 2);
+            host[strlen(host) - 2] = '\0';
+        }
+        struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+        if (getaddrinfo(host, port + 1, &hints, &addresses) != 0) return -1;
+    }
+
+    struct timeval tv = {u->timeout / 1000000000, (u->timeout % 1000000000) / 1000};
+    int fd = -1;
+    for (struct addrinfo* ai = addresses ? addresses : &unix_address; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, 0);
+        if (fd < 0) continue;
+
+        int one = 1;
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        int rc = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc < 0 && errno == EINPROGRESS) {
+            struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+            int error = 0;
+            socklen_t len = sizeof(error);
+            rc = poll(&pfd, 1, (int)(u->timeout / 1000000)) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0 ? 0 : -1;
+        }
+        if (rc == 0) {
+            fcntl(fd, F_SETFL, 0);
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+            if (ai->ai_family != AF_UNIX) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        } else {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (addresses) freeaddrinfo(addresses);
+    return fd;
+}
+
+/* Sends one frame and waits for its acknowledgement. */
+static int uplink_send(int fd, const unsigned char* data, size_t length, uint64_t seq) {
+    while (length) {
+        ssize_t n = send(fd, data, length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        length -= n;
+    }
+
+    unsigned char ack[8];
+    size_t got = 0;
+    while (got < sizeof(ack)) {
+        ssize_t n = recv(fd, ack + got, sizeof(ack) - got, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        got += n;
+    }
+    return get_le(ack, 8) == seq ? 0 : -1;
+}
+
+static int uplink_send_spooled(UplinkObject* u) {
+    char path[PATH_MAX];
+    uplink_spool_path(u, u->spool[0].seq, "mlux", path);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        uplink_spool_pop(u, 0);
+        return 0;
+    }
+
+    size_t length = (size_t)u->spool[0].bytes;
+    unsigned char* data = PyMem_RawMalloc(length);
+    int ok = data && read(fd, data, length) == (ssize_t)length;
+    close(fd);
+    if (!ok) {
+        PyMem_RawFree(data);
+        uplink_spool_pop(u, 0);
+        return 0;
+    }
+
+    int rc = uplink_send(u->fd, data, length, u->spool[0].seq);
+    PyMem_RawFree(data);
+    if (rc == 0) uplink_spool_pop(u, 1);
+    return rc;
+}
+
+static void uplink_disconnect(UplinkObject* u) {
+    if (u->fd >= 0) close(u->fd);
+    u->fd = -1;
+    pthread_mutex_lock(&u->lock);
+    u->connected = 0;
+    pthread_mutex_unlock(&u->lock);
+}
+
+static void* uplink_main(void* arg) {
+    UplinkObject* u = arg;
+    int64_t retry_at = 0, backoff = UPLINK_MIN_BACKOFF_NS;
+
+    pthread_mutex_lock(&u->lock);
+    for (;;) {
+        int64_t now = monotonic_ns();
+        int running = u->running;
+        if (u->batch.length && (!running || now - u->batch_started >= u->max_delay)) uplink_seal(u);
+        UplinkBatch* sealed = u->sealed;
+        u->sealed = NULL;
+        u->sealed_tail = &u->sealed;
+        pthread_mutex_unlock(&u->lock);
+
+        UplinkFrame** tail = &u->frames;
+        while (*tail) tail = &(*tail)->next;
+        while (sealed) {
+            UplinkBatch* b = sealed;
+            sealed = b->next;
+            if (u->spool_dir[0] && b->seq >= u->seq_reserved) uplink_reserve_seq(u, b->seq);
+            UplinkFrame* f = uplink_compress(u, b);
+            if (f) {
+                *tail = f;
+                tail = &f->next;
+                u->frame_count++;
+            } else {
+                uplink_count(u, &u->dropped, b->buf.length, b->buf.length);
+            }
+            SampleBuf_clear(&b->buf);
+            PyMem_RawFree(b);
+        }
+
+        int pending = u->frames || u->spool_count;
+        if (pending && u->fd < 0 && (now >= retry_at || !running)) {
+            u->fd = uplink_connect(u);
+            if (u->fd < 0) {
+                retry_at = now + backoff;
+                backoff = backoff * 2 < UPLINK_MAX_BACKOFF_NS ? backoff * 2 : UPLINK_MAX_BACKOFF_NS;
+            } else {
+                backoff = UPLINK_MIN_BACKOFF_NS;
+                pthread_mutex_lock(&u->lock);
+                u->connected = 1;
+                pthread_mutex_unlock(&u->lock);
+            }
+        }
+
+        while (u->fd >= 0 && (u->frames || u->spool_count)) {
+            if (u->spool_count) {
+                if (uplink_send_spooled(u) == 0) continue;
+            } else {
+                UplinkFrame* f = u->frames;
+                if (uplink_send(u->fd, f->data, f->length, f->seq) == 0) {
+                    u->frames = f->next;
+                    u->frame_count--;
+                    uplink_count(u, &u->sent, f->count, f->count);
+                    PyMem_RawFree(f);
+                    continue;
+                }
+            }
+            uplink_disconnect(u);
+            retry_at = monotonic_ns() + backoff;
+        }
+
+        if (u->fd < 0 && u->spool_dir[0]) {
+            while (u->frames) uplink_offload(u);
+        }
+        while (u->frame_count > UPLINK_MEMORY_FRAMES || (!running && u->frames)) uplink_offload(u);
+
+        pthread_mutex_lock(&u->lock);
+        if (!running) break;
+        if (!u->sealed && u->running) {
+            int64_t wait = u->batch.length ? u->batch_started + u->max_delay - monotonic_ns() : u->max_delay;
+            if ((u->frames || u->spool_count) && retry_at - monotonic_ns() < wait) wait = retry_at - monotonic_ns();
+            if (wait > 0) {
+                struct timespec rel = {wait / 1000000000, wait % 1000000000};
+                pthread_cond_timedwait_relative_np(&u->cond, &u->lock, &rel);
+            }
+        }
+    }
+    pthread_mutex_unlock(&u->lock);
+
+    uplink_disconnect(u);
+    return NULL;
+}
+
+static void Uplink_unlock_spool(UplinkObject* self) {
+    if (self->spool_lock >= 0) close(self->spool_lock);
+    self->spool_lock = -1;
+}
+
+static void Uplink_close_thread(UplinkObject* self) {
+    if (!self->started) return;
+    self->started = 0;
+
+    pthread_mutex_lock(&self->lock);
+    self->running = 0;
+    pthread_cond_signal(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_join(self->thread, NULL);
+    Py_END_ALLOW_THREADS
+    Uplink_unlock_spool(self);
+}
+
+static void Uplink_dealloc(UplinkObject* self) {
+    if (self->initialized) {
+        Uplink_close_thread(self);
+        while (self->sealed) {
+            UplinkBatch* b = self->sealed;
+            self->sealed = b->next;
+            SampleBuf_clear(&b->buf);
+            PyMem_RawFree(b);
+        }
+        pthread_cond_destroy(&self->cond);
+        pthread_mutex_destroy(&self->lock);
+    }
+    Uplink_unlock_spool(self);
+    SampleBuf_clear(&self->batch);
+    PyMem_RawFree(self->spool);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Uplink_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+    UplinkObject* self = (UplinkObject*)type->tp_alloc(type, 0);
+    if (self) {
+        self->fd = -1;
+        self->spool_lock = -1;
+    }
+    return (PyObject*)self;
+}
+
+static int Uplink_init(UplinkObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"address", "spool_dir", "spool_max_bytes", "batch", "max_delay_ns", "timeout_ns", "level", NULL};
+    const char* address;
+    PyObject* spool_dir = Py_None;
+    long long spool_max = 64LL << 20, max_delay = 1000000000LL, timeout = 5000000000LL;
+    Py_ssize_t batch = 1024;
+    int level = Z_DEFAULT_COMPRESSION;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OLnLLi", kwlist, &address, &spool_dir, &spool_max, &batch, &max_delay, &timeout, &level)) {
+        return -1;
+    }
+
+    if (self->initialized) {
+        PyErr_SetString(PyExc_RuntimeError, "Uplink cannot be reinitialized.");
+        return -1;
+    }
+    if (strncmp(address, "tcp://", 6) != 0 && strncmp(address, "unix://", 7) != 0) {
+        PyErr_SetString(PyExc_ValueError, "address must be tcp://host:port or unix:///path.");
+        return -1;
+    }
+    if (strlen(address) >= sizeof(self->address)) {
+        PyErr_SetString(PyExc_ValueError, "address is too long.");
+        return -1;
+    }
+    if (batch < 1 || max_delay <= 0 || timeout <= 0 || level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION) {
+        PyErr_SetString(PyExc_ValueError, "batch, max_delay_ns and timeout_ns must be positive and level between -1 and 9.");
+        return -1;
+    }
+
+    if (spool_dir != Py_None) {
+        PyObject* path_bytes = NULL;
+        if (!PyUnicode_FSConverter(spool_dir, &path_bytes)) return -1;
+        const char* path = PyBytes_AS_STRING(path_bytes);
+        if (strlen(path) >= sizeof(self->spool_dir)) {
+            Py_DECREF(path_bytes);
+            PyErr_SetString(PyExc_ValueError, "spool_dir is too long.");
+            return -1;
+        }
+        if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, spool_dir);
+            Py_DECREF(path_bytes);
+            return -1;
+        }
+
+        char lock_path[PATH_MAX];
+        snprintf(lock_path, sizeof(lock_path), "%s/lock", path);
+        Py_DECREF(path_bytes);
+        int fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, spool_dir);
+            return -1;
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+            int error = errno;
+            close(fd);
+            if (error == EWOULDBLOCK) {
+                PyErr_SetString(PyExc_RuntimeError, "spool_dir is in use by another Uplink.");
+            } else {
+                errno = error;
+                PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, spool_dir);
+            }
+            return -1;
+        }
+        self->spool_lock = fd;
+        snprintf(self->spool_dir, sizeof(self->spool_dir), "%s", path);
+    }
+
+    snprintf(self->address, sizeof(self->address), "%s", address);
+    self->spool_max = spool_max;
+    self->batch_size = batch;
+    self->max_delay = max_delay;
+    self->timeout = timeout;
+    self->level = level;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    self->next_seq = (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+    self->sealed_tail = &self->sealed;
+    if (self->spool_dir[0]) {
+        uint64_t saved = uplink_load_seq(self);
+        if (saved > self->next_seq) self->next_seq = saved;
+        uplink_spool_scan(self);
+        self->seq_reserved = self->next_seq;
+    }
+
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->cond, NULL);
+    self->initialized = 1;
+    self->running = 1;
+    if (pthread_create(&self->thread, NULL, uplink_main, self) != 0) {
+        self->running = 0;
+        Uplink_unlock_spool(self);
+        PyErr_SetString(PyExc_RuntimeError, "Could not start the uplink sender thread.");
+        return -1;
+    }
+    self->started = 1;
+    return 0;
+}
+
+static int Uplink_check_open(UplinkObject* self) {
+    if (self->started) return 0;
+    PyErr_SetString(PyExc_RuntimeError, "Uplink is closed.");
+    return -1;
+}
+
+static PyObject* Uplink_push(UplinkObject* self, PyObject* args) {
+    long long timestamp;
+    double value;
+    if (!PyArg_ParseTuple(args, "Ld", &timestamp, &value)) return NULL;
+    if (Uplink_check_open(self) < 0) return NULL;
+
+    if (uplink_append(self, timestamp, value) < 0) return PyErr_NoMemory();
+    Py_RETURN_NONE;
+}
+
+static PyObject* Uplink_extend(UplinkObject* self, PyObject* args) {
+    PyObject *ts_obj, *values_obj;
+    if (!PyArg_ParseTuple(args, "OO", &ts_obj, &values_obj)) return NULL;
+    if (Uplink_check_open(self) < 0) return NULL;
+
+    ColumnArg ts, vals;
+    if (ColumnArg_load_samples(ts_obj, values_obj, &ts, &vals) < 0) return NULL;
+
+    int rc = 0;
+    for (Py_ssize_t i = 0; rc == 0 && i < ts.length; i++) {
+        rc = uplink_append(self, ((int64_t*)ts.data)[i], ((double*)vals.data)[i]);
+    }
+    ColumnArg_release(&ts);
+    ColumnArg_release(&vals);
+
+    if (rc < 0) return PyErr_NoMemory();
+    Py_RETURN_NONE;
+}
+
+/* Seals the open batch so the sender ships it without waiting for
+ * max_delay_ns. Safe without the GIL. */
+static int uplink_flush(UplinkObject* u) {
+    pthread_mutex_lock(&u->lock);
+    int rc = u->batch.length ? uplink_seal(u) : 0;
+    pthread_cond_signal(&u->cond);
+    pthread_mutex_unlock(&u->lock);
+    return rc;
+}
+
+static PyObject* Uplink_flush(UplinkObject* self, PyObject* Py_UNUSED(ignored)) {
+    if (Uplink_check_open(self) < 0) return NULL;
+    if (uplink_flush(self) < 0) return PyErr_NoMemory();
+    Py_RETURN_NONE;
+}
+
+static PyObject* Uplink_close(UplinkObject* self, PyObject* Py_UNUSED(ignored)) {
+    Uplink_close_thread(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Uplink_counter(UplinkObject* self, const uint64_t* counter) {
+    pthread_mutex_lock(&self->lock);
+    uint64_t value = *counter;
+    pthread_mutex_unlock(&self->lock);
+    return PyLong_FromUnsignedLongLong(value);
+}
+
+static PyObject* Uplink_get_connected(UplinkObject* self, void* closure) {
+    pthread_mutex_lock(&self->lock);
+    int connected = self->connected;
+    pthread_mutex_unlock(&self->lock);
+    return PyBool_FromLong(connected);
+}
+
+static PyObject* Uplink_get_queued(UplinkObject* self, void* closure) {
+    return Uplink_counter(self, &self->queued);
+}
+
+static PyObject* Uplink_get_sent(UplinkObject* self, void* closure) {
+    return Uplink_counter(self, &self->sent);
+}
+
+static PyObject* Uplink_get_spooled(UplinkObject* self, void* closure) {
+    return Uplink_counter(self, &self->spooled);
+}
+
+static PyObject* Uplink_get_dropped(UplinkObject* self, void* closure) {
+    return Uplink_counter(self, &self->dropped);
+}
+
+static PyGetSetDef Uplink_getset[] = {
+    {"connected", (getter)Uplink_get_connected, NULL, "whether the sender is connected to the collector", NULL},
+    {"queued", (getter)Uplink_get_queued, NULL, "number of readings held in memory waiting to be sent", NULL},
+    {"sent", (getter)Uplink_get_sent, NULL, "number of readings acknowledged by the collector", NULL},
+    {"spooled", (getter)Uplink_get_spooled, NULL, "number of readings waiting in the spool directory", NULL},
+    {"dropped", (getter)Uplink_get_dropped, NULL, "number of readings discarded because the queue or spool was full", NULL},
+    {NULL}
+};
+
+static PyMethodDef Uplink_methods[] = {
+    {"push", (PyCFunction)Uplink_push, METH_VARARGS, PyDoc_STR("Queue one reading for the collector.")},
+    {"extend", (PyCFunction)Uplink_extend, METH_VARARGS, PyDoc_STR("Queue timestamp and value columns for the collector.")},
+    {"flush", (PyCFunction)Uplink_flush, METH_NOARGS, PyDoc_STR("Send the partial batch without waiting for max_delay_ns.")},
+    {"close", (PyCFunction)Uplink_close, METH_NOARGS, PyDoc_STR("Send or spool everything queued and stop the sender thread.")},
+    {NULL}
+};
+
+static PyTypeObject UplinkType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.Uplink",
+    .tp_basicsize = sizeof(UplinkObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Compressed, acknowledged batch uplink with an on-disk spool",
+    .tp_methods = Uplink_methods,
+    .tp_getset = Uplink_getset,
+    .tp_dealloc = (destructor)Uplink_dealloc,
+    .tp_init = (initproc)Uplink_init,
+    .tp_new = Uplink_new,
+};
+
+/* Pipeline: calibrate -> filter -> deadband -> stats -> sinks, run natively
+ * on whichever thread feeds it. An optional flicker stage taps the
+ * calibrated readings before the filter and keeps the last
+ * PIPELINE_FLICKER_WINDOWS completed windows. Stage state is guarded by an unfair lock so
+ * scheduler workers and push() can share a pipeline. The callback sink only
+ * takes the GIL once per full batch, outside the lock. */
+
+#define PIPELINE_MEDIAN_MAX 15
+#define PIPELINE_RECORD_BATCH 256
+#define PIPELINE_FLICKER_WINDOWS 64
+
+enum { FILTER_NONE, FILTER_EMA, FILTER_MEDIAN };
+
+typedef struct {
+    int64_t timestamp;
+    double value;
+} PipelineRecord;
+
+typedef struct {
+    PyObject_HEAD
+    os_unfair_lock lock;
+    int initialized;
+
+    double gain;
+    double offset;
+
+    int has_flicker;
+    FlickerState flicker;
+    FlickerResult flicker_windows[PIPELINE_FLICKER_WINDOWS];
+    int flicker_head;
+    int flicker_count;
+
+    int filter;
+    double alpha;
+    int64_t time_constant;
+    double ema;
+    int64_t ema_timestamp;
+    int ema_primed;
+    double window[PIPELINE_MEDIAN_MAX];
+    int window_size;
+    int window_len;
+    int window_pos;
+
+    int deadband;
+    double band_absolute;
+    double band_relative;
+    int64_t heartbeat;
+    double last_value;
+    int64_t last_timestamp;
+    int have_last;
+
+    int has_stats;
+    uint64_t stats_count;
+    double stats_mean;
+    double stats_m2;
+    double stats_min;
+    double stats_max;
+
+    int has_ring;
+    SampleRing ring;
+    int recorder_fd;
+    int recorder_errno;
+    PipelineRecord records[PIPELINE_RECORD_BATCH];
+    Py_ssize_t record_count;
+    PyObject* callback;
+    SampleBuf callback_buf;
+    Py_ssize_t callback_batch;
+    UplinkObject* uplink;
+    BacklightControllerObject* backlight;
+    int backlight_errno;
+
+    uint64_t samples;
+    uint64_t emitted;
+} PipelineObject;
+
+static void pipeline_flush_records(PipelineObject* p) {
+    const char* data = (const char*)p->records;
+    size_t left = p->record_count * sizeof(PipelineRecord);
+    while (left) {
+        ssize_t n = write(p->recorder_fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            p->recorder_errno = errno;
+            break;
+        }
+        data += n;
+        left -= n;
+    }
+    p->record_count = 0;
+}
+
+static double pipeline_median(const PipelineObject* p) {
+    double sorted[PIPELINE_MEDIAN_MAX];
+    int n = p->window_len;
+    for (int i = 0; i < n; i++) {
+        double v = p->window[i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+#define PIPELINE_ERR_MEMORY -1
+#define PIPELINE_ERR_ORDER -3
+
+/* Runs one reading through the stages with p->lock held. Returns 1 when it
+ * reached the sinks, 0 when the deadband held it back, PIPELINE_ERR_ORDER
+ * when a ring sink already holds a later reading and PIPELINE_ERR_MEMORY
+ * when out of memory. A full callback batch is moved into *ready for
+ * delivery. */
+static int pipeline_process(PipelineObject* p, int64_t timestamp, double value, SampleBuf* ready) {
+    if (p->has_ring && p->ring.head && timestamp < SampleRing_timestamp(&p->ring, (p->ring.head - 1) % p->ring.slots)) {
+        return PIPELINE_ERR_ORDER;
+    }
+    p->samples++;
+    value = value * p->gain + p->offset;
+
+    FlickerResult window;
+    if (p->has_flicker && flicker_push(&p->flicker, timestamp, value, &window)) {
+        if (p->flicker_count == PIPELINE_FLICKER_WINDOWS) {
+            p->flicker_head = (p->flicker_head + 1) % PIPELINE_FLICKER_WINDOWS;
+            p->flicker_count--;
+        }
+        p->flicker_windows[(p->flicker_head + p->flicker_count++) % PIPELINE_FLICKER_WINDOWS] = window;
+    }
+
+    if (p->filter == FILTER_EMA) {
+        if (!p->ema_primed) {
+            p->ema = value;
+            p->ema_primed = 1;
+        } else {
+            double alpha = p->alpha;
+            if (p->time_constant) {
+                int64_t dt = timestamp - p->ema_timestamp;
+                alpha = dt > 0 ? 1.0 - exp(-(double)dt / (double)p->time_constant) : 0.0;
+            }
+            p->ema += alpha * (value - p->ema);
+        }
+        p->ema_timestamp = timestamp;
+        value = p->ema;
+    } else if (p->filter == FILTER_MEDIAN) {
+        p->window[p->window_pos] = value;
+        p->window_pos = (p->window_pos + 1) % p->window_size;
+        if (p->window_len < p->window_size) p->window_len++;
+        value = pipeline_median(p);
+    }
+
+    if (p->deadband && p->have_last) {
+        double band = p->band_absolute;
+        double relative = p->band_relative * fabs(p->last_value);
+        if (p->band_relative > 0 && (band <= 0 || relative < band)) band = relative;
+        int stale = p->heartbeat && timestamp - p->last_timestamp >= p->heartbeat;
+        if (fabs(value - p->last_value) <= band && !stale) return 0;
+    }
+    p->last_value = value;
+    p->last_timestamp = timestamp;
+    p->have_last = 1;
+    p->emitted++;
+
+    if (p->has_stats) {
+        p->stats_count++;
+        double delta = value - p->stats_mean;
+        p->stats_mean += delta / (double)p->stats_count;
+        p->stats_m2 += delta * (value - p->stats_mean);
+        if (p->stats_count == 1 || value < p->stats_min) p->stats_min = value;
+        if (p->stats_count == 1 || value > p->stats_max) p->stats_max = value;
+    }
+
+    if (p->has_ring) SampleRing_push(&p->ring, timestamp, value);
+    if (p->recorder_fd >= 0) {
+        p->records[p->record_count++] = (PipelineRecord){timestamp, value};
+        if (p->record_count == PIPELINE_RECORD_BATCH) pipeline_flush_records(p);
+    }
+    if (p->backlight && backlight_feed(p->backlight, value, timestamp) < 0) p->backlight_errno = errno;
+    if (p->uplink && uplink_append(p->uplink, timestamp, value) < 0) return PIPELINE_ERR_MEMORY;
+    if (p->callback) {
+        if (SampleBuf_append(&p->callback_buf, timestamp, value) < 0) return PIPELINE_ERR_MEMORY;
+        if (p->callback_buf.length >= p->callback_batch) {
+            *ready = p->callback_buf;
+            memset(&p->callback_buf, 0, sizeof(p->callback_buf));
+        }
+    }
+    return 1;
+}
+
+/* Hands a callback batch to Python; the buffer is consumed. Needs the GIL. */
+static int pipeline_deliver(PipelineObject* p, SampleBuf* buf) {
+    PyObject* batch = SampleBatch_from_buf(buf);
+    if (!batch) return -1;
+    PyObject* result = PyObject_CallOneArg(p->callback, batch);
+    Py_DECREF(batch);
+    if (!result) return -1;
+    Py_DECREF(result);
+    return 0;
+}
+
+/* Entry point for threads that do not hold the GIL. */
+static int Pipeline_feed(PipelineObject* p, int64_t timestamp, double value) {
+    SampleBuf ready = {0};
+    os_unfair_lock_lock(&p->lock);
+    int rc = pipeline_process(p, timestamp, value, &ready);
+    os_unfair_lock_unlock(&p->lock);
+
+    if (ready.length) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        if (pipeline_deliver(p, &ready) < 0) PyErr_WriteUnraisable(p->callback);
+        PyGILState_Release(gil);
+    }
+    return rc;
+}
+
+static void Pipeline_dealloc(PipelineObject* self) {
+    if (self->recorder_fd >= 0) {
+        pipeline_flush_records(self);
+        close(self->recorder_fd);
+    }
+    SampleRing_clear(&self->ring);
+    flicker_state_clear(&self->flicker);
+    SampleBuf_clear(&self->callback_buf);
+    Py_XDECREF(self->callback);
+    Py_XDECREF(self->uplink);
+    Py_XDECREF(self->backlight);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Pipeline_new(PyTypeObject* type, PyObject* args, PyObject* kwds) {
+    PipelineObject* self = (PipelineObject*)type->tp_alloc(type, 0);
+    if (self) {
+        self->recorder_fd = -1;
+        self->gain = 1.0;
+    }
+    return (PyObject*)self;
+}
+
+/* Looks up an optional stage table; *table is NULL when the stage is absent. */
+static int spec_table(PyObject* spec, const char* stage, PyObject** table) {
+    *table = PyDict_GetItemString(spec, stage);
+    if (*table && !PyDict_Check(*table)) {
+        PyErr_Format(PyExc_TypeError, "Pipeline stage '%s' must be a table.", stage);
+        return -1;
+    }
+    return 0;
+}
+
+static int spec_double(PyObject* table, const char* key, double* out) {
+    PyObject* value = PyDict_GetItemString(table, key);
+    if (!value) return 0;
+    *out = PyFloat_AsDouble(value);
+    return *out == -1.0 && PyErr_Occurred() ? -1 : 0;
+}
+
+static int spec_int64(PyObject* table, const char* key, int64_t* out) {
+    PyObject* value = PyDict_GetItemString(table, key);
+    if (!value) return 0;
+    *out = PyLong_AsLongLong(value);
+    return *out == -1 && PyErr_Occurred() ? -1 : 0;
+}
+
+static const char* spec_string(PyObject* table, const char* key, const char* fallback) {
+    PyObject* value = PyDict_GetItemString(table, key);
+    if (!value) return fallback;
+    if (!PyUnicode_Check(value)) {
+        PyErr_Format(PyExc_TypeError, "'%s' must be a string.", key);
+        return NULL;
+    }
+    return PyUnicode_AsUTF8(value);
+}
+
+static int Pipeline_add_sink(PipelineObject* self, PyObject* sink) {
+    if (!PyDict_Check(sink)) {
+        PyErr_SetString(PyExc_TypeError, "Each sink must be a table with a 'type'.");
+        return -1;
+    }
+    const char* type = spec_string(sink, "type", NULL);
+    if (!type) {
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "Each sink needs a 'type'.");
+        return -1;
+    }
+
+    if (strcmp(type, "ring") == 0 && !self->has_ring) {
+        int64_t capacity = 4096;
+        const char* format_name = spec_string(sink, "format", "float64");
+        if (!format_name || spec_int64(sink, "capacity", &capacity) < 0) return -1;
+        int format = 0;
+        while (ring_format_names[format] && strcmp(ring_format_names[format], format_name) != 0) format++;
+        if (!ring_format_names[format] || capacity <= 0) {
+            PyErr_SetString(PyExc_ValueError, "ring sinks need a positive capacity and a known format.");
+            return -1;
+        }
+        if (SampleRing_init(&self->ring, (Py_ssize_t)capacity, (RingFormat)format) < 0) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->has_ring = 1;
+        return 0;
+    }
+
+    if (strcmp(type, "recorder") == 0 && self->recorder_fd < 0) {
+        PyObject* path = PyDict_GetItemString(sink, "path");
+        PyObject* path_bytes = NULL;
+        if (!path) {
+            PyErr_SetString(PyExc_ValueError, "recorder sinks need a 'path'.");
+            return -1;
+        }
+        if (!PyUnicode_FSConverter(path, &path_bytes)) return -1;
+        self->recorder_fd = open(PyBytes_AS_STRING(path_bytes), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (self->recorder_fd < 0) PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+        Py_DECREF(path_bytes);
+        return self->recorder_fd < 0 ? -1 : 0;
+    }
+
+    if (strcmp(type, "callback") == 0 && !self->callback) {
+        PyObject* function = PyDict_GetItemString(sink, "function");
+        int64_t batch = 64;
+        if (!function || !PyCallable_Check(function)) {
+            PyErr_SetString(PyExc_TypeError, "callback sinks need a callable 'function'.");
+            return -1;
+        }
+        if (spec_int64(sink, "batch", &batch) < 0) return -1;
+        if (batch < 1) {
+            PyErr_SetString(PyExc_ValueError, "callback batch must be at least 1.");
+            return -1;
+        }
+        Py_INCREF(function);
+        self->callback = function;
+        self->callback_batch = (Py_ssize_t)batch;
+        return 0;
+    }
+
+    if (strcmp(type, "uplink") == 0 && !self->uplink) {
+        PyObject* uplink = PyDict_GetItemString(sink, "uplink");
+        if (uplink) {
+            if (!PyObject_TypeCheck(uplink, &UplinkType)) {
+                PyErr_SetString(PyExc_TypeError, "'uplink' must be an Uplink.");
+                return -1;
+            }
+            Py_INCREF(uplink);
+        } else {
+            PyObject* options = PyDict_Copy(sink);
+            PyObject* empty = PyTuple_New(0);
+            if (options && empty && PyDict_DelItemString(options, "type") == 0) {
+                uplink = PyObject_Call((PyObject*)&UplinkType, empty, options);
+            }
+            Py_XDECREF(options);
+            Py_XDECREF(empty);
+            if (!uplink) return -1;
+        }
+        self->uplink = (UplinkObject*)uplink;
+        return 0;
+    }
+
+    if (strcmp(type, "backlight") == 0 && !self->backlight) {
+        PyObject* controller = PyDict_GetItemString(sink, "controller");
+        if (!controller || !PyObject_TypeCheck(controller, &BacklightControllerType)) {
+            PyErr_SetString(PyExc_TypeError, "backlight sinks need a BacklightController 'controller'.");
+            return -1;
+        }
+        BacklightControllerObject* backlight = (BacklightControllerObject*)controller;
+        if (check_initialized(backlight, backlight->curve_len > 0) < 0) return -1;
+        if (backlight->callback) {
+            PyErr_SetString(PyExc_ValueError, "backlight sinks need a controller writing to a file or backlight directory.");
+            return -1;
+        }
+        Py_INCREF(controller);
+        self->backlight = backlight;
+        return 0;
+    }
+
+    PyErr_Format(PyExc_ValueError, "Unknown or repeated sink type '%s'.", type);
+    return -1;
+}
+
+static int Pipeline_init(PipelineObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"spec", NULL};
+    static const char* stages[] = {"calibrate", "flicker", "filter", "deadband", "stats", "sinks", NULL};
+    PyObject* spec;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!", kwlist, &PyDict_Type, &spec)) return -1;
+
+    if (self->initialized) {
+        PyErr_SetString(PyExc_RuntimeError, "Pipeline cannot be reinitialized.");
+        return -1;
+    }
+    self->initialized = 1;
+
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(spec, &pos, &key, &value)) {
+        const char* name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+        int known = 0;
+        for (int i = 0; name && stages[i]; i++) known |= strcmp(name, stages[i]) == 0;
+        if (!known) {
+            PyErr_Format(PyExc_ValueError, "Unknown pipeline stage %R.", key);
+            return -1;
+        }
+    }
+
+    PyObject* table;
+    if (spec_table(spec, "calibrate", &table) < 0) return -1;
+    if (table && (spec_double(table, "gain", &self->gain) < 0 || spec_double(table, "offset", &self->offset) < 0)) return -1;
+
+    if (spec_table(spec, "flicker", &table) < 0) return -1;
+    if (table) {
+        double sample_rate = 0, min_hz = 0, max_hz = 0;
+        int64_t window = 256;
+        if (spec_double(table, "sample_rate_hz", &sample_rate) < 0 || spec_int64(table, "window", &window) < 0 ||
+            spec_double(table, "min_hz", &min_hz) < 0 || spec_double(table, "max_hz", &max_hz) < 0) {
+            return -1;
+        }
+        if (flicker_state_init(&self->flicker, sample_rate, (Py_ssize_t)window, min_hz, max_hz) < 0) return -1;
+        self->has_flicker = 1;
+    }
+
+    if (spec_table(spec, "filter", &table) < 0) return -1;
+    if (table) {
+        const char* type = spec_string(table, "type", "ema");
+        if (!type) return -1;
+        if (strcmp(type, "ema") == 0) {
+            self->filter = FILTER_EMA;
+            self->alpha = 1.0;
+            if (spec_double(table, "alpha", &self->alpha) < 0 || spec_int64(table, "time_constant_ns", &self->time_constant) < 0) return -1;
+            if (self->alpha <= 0 || self->alpha > 1 || self->time_constant < 0) {
+                PyErr_SetString(PyExc_ValueError, "ema filters need 0 < alpha <= 1 and a non-negative time_constant_ns.");
+                return -1;
+            }
+        } else if (strcmp(type, "median") == 0) {
+            int64_t window = 5;
+            if (spec_int64(table, "window", &window) < 0) return -1;
+            if (window < 1 || window > PIPELINE_MEDIAN_MAX) {
+                PyErr_Format(PyExc_ValueError, "median window must be between 1 and %d.", PIPELINE_MEDIAN_MAX);
+                return -1;
+            }
+            self->filter = FILTER_MEDIAN;
+            self->window_size = (int)window;
+        } else {
+            PyErr_Format(PyExc_ValueError, "Unknown filter type '%s' (expected ema or median).", type);
+            return -1;
+        }
+    }
+
+    if (spec_table(spec, "deadband", &table) < 0) return -1;
+    if (table) {
+        self->deadband = 1;
+        if (spec_double(table, "absolute", &self->band_absolute) < 0 ||
+            spec_double(table, "relative", &self->band_relative) < 0 ||
+            spec_int64(table, "max_interval_ns", &self->heartbeat) < 0) {
+            return -1;
+        }
+    }
+
+    value = PyDict_GetItemString(spec, "stats");
+    self->has_stats = value && (PyDict_Check(value) || PyObject_IsTrue(value) == 1);
+
+    PyObject* sinks = PyDict_GetItemString(spec, "sinks");
+    if (sinks) {
+        PyObject* seq = PySequence_Fast(sinks, "sinks must be a list of tables.");
+        if (!seq) return -1;
+        for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+            if (Pipeline_add_sink(self, PySequence_Fast_GET_ITEM(seq, i)) < 0) {
+                Py_DECREF(seq);
+                return -1;
+            }
+        }
+        Py_DECREF(seq);
+    }
+    return 0;
+}
+
+static PyObject* Pipeline_from_toml(PyObject* cls, PyObject* text) {
+    PyObject* tomllib = PyImport_ImportModule("tomllib");
+    if (!tomllib) return NULL;
+    PyObject* spec = PyObject_CallMethod(tomllib, "loads", "O", text);
+    Py_DECREF(tomllib);
+    if (!spec) return NULL;
+    PyObject* pipeline = PyObject_CallOneArg(cls, spec);
+    Py_DECREF(spec);
+    return pipeline;
+}
+
+static PyObject* set_pipeline_error(int rc) {
+    if (rc == PIPELINE_ERR_ORDER) {
+        PyErr_SetString(PyExc_ValueError, "Timestamps must be non-decreasing.");
+    } else {
+        PyErr_NoMemory();
+    }
+    return NULL;
+}
+
+static PyObject* Pipeline_push(PipelineObject* self, PyObject* args) {
+    long long timestamp;
+    double value;
+    if (!PyArg_ParseTuple(args, "Ld", &timestamp, &value)) return NULL;
+
+    SampleBuf ready = {0};
+    os_unfair_lock_lock(&self->lock);
+    int rc = pipeline_process(self, timestamp, value, &ready);
+    double emitted = self->last_value;
+    os_unfair_lock_unlock(&self->lock);
+
+    if (ready.length && pipeline_deliver(self, &ready) < 0) return NULL;
+    if (rc < 0) return set_pipeline_error(rc);
+    if (rc == 0) Py_RETURN_NONE;
+    return PyFloat_FromDouble(emitted);
+}
+
+static PyObject* Pipeline_extend(PipelineObject* self, PyObject* args) {
+    PyObject *ts_obj, *values_obj;
+    if (!PyArg_ParseTuple(args, "OO", &ts_obj, &values_obj)) return NULL;
+
+    ColumnArg ts, vals;
+    if (ColumnArg_load_samples(ts_obj, values_obj, &ts, &vals) < 0) return NULL;
+
+    Py_ssize_t emitted = 0;
+    int rc = 0;
+    for (Py_ssize_t i = 0; rc >= 0 && i < ts.length; i++) {
+        SampleBuf ready = {0};
+        os_unfair_lock_lock(&self->lock);
+        rc = pipeline_process(self, ((int64_t*)ts.data)[i], ((double*)vals.data)[i], &ready);
+        os_unfair_lock_unlock(&self->lock);
+        if (rc > 0) emitted++;
+        if (ready.length && pipeline_deliver(self, &ready) < 0) rc = -2;
+    }
+    ColumnArg_release(&ts);
+    ColumnArg_release(&vals);
+
+    if (rc == -2) return NULL;
+    if (rc < 0) return set_pipeline_error(rc);
+    return PyLong_FromSsize_t(emitted);
+}
+
+static PyObject* Pipeline_flush(PipelineObject* self, PyObject* Py_UNUSED(ignored)) {
+    os_unfair_lock_lock(&self->lock);
+    if (self->recorder_fd >= 0) pipeline_flush_records(self);
+    int error = self->recorder_errno ? self->recorder_errno : self->backlight_errno;
+    self->recorder_errno = self->backlight_errno = 0;
+    SampleBuf ready = self->callback_buf;
+    memset(&self->callback_buf, 0, sizeof(self->callback_buf));
+    os_unfair_lock_unlock(&self->lock);
+
+    if (self->uplink && uplink_flush(self->uplink) < 0) {
+        SampleBuf_clear(&ready);
+        return PyErr_NoMemory();
+    }
+    if (ready.length) {
+        if (pipeline_deliver(self, &ready) < 0) return NULL;
+    } else {
+        SampleBuf_clear(&ready);
+    }
+    if (error) {
+        errno = error;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    Py_RETURN_NONE;
+}
+
+static int Pipeline_check_ring(PipelineObject* self) {
+    if (self->has_ring) return 0;
+    PyErr_SetString(PyExc_RuntimeError, "Pipeline has no ring sink.");
+    return -1;
+}
+
+static PyObject* Pipeline_drain(PipelineObject* self, PyObject* args) {
+    Py_ssize_t max_samples = -1;
+    if (!PyArg_ParseTuple(args, "|n", &max_samples)) return NULL;
+    if (Pipeline_check_ring(self) < 0) return NULL;
+
+    SampleBuf out = {0};
+    os_unfair_lock_lock(&self->lock);
+    int rc = SampleRing_drain(&self->ring, max_samples, &out);
+    os_unfair_lock_unlock(&self->lock);
+    if (rc < 0) {
+        SampleBuf_clear(&out);
+        return PyErr_NoMemory();
+    }
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* Pipeline_history(PipelineObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"since_ns", "until_ns", NULL};
+    long long since = INT64_MIN, until = INT64_MAX;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|LL", kwlist, &since, &until)) return NULL;
+    if (Pipeline_check_ring(self) < 0) return NULL;
+
+    SampleBuf out = {0};
+    os_unfair_lock_lock(&self->lock);
+    int rc = SampleRing_history(&self->ring, since, until, &out);
+    os_unfair_lock_unlock(&self->lock);
+    if (rc < 0) {
+        SampleBuf_clear(&out);
+        return PyErr_NoMemory();
+    }
+    return SampleBatch_from_buf(&out);
+}
+
+static PyObject* Pipeline_stats(PipelineObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"reset", NULL};
+    int reset = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) return NULL;
+
+    if (!self->has_stats) {
+        PyErr_SetString(PyExc_RuntimeError, "Pipeline has no stats stage.");
+        return NULL;
+    }
+
+    os_unfair_lock_lock(&self->lock);
+    uint64_t count = self->stats_count;
+    double mean = self->stats_mean;
+    double stdev = count > 1 ? sqrt(self->stats_m2 / (double)(count - 1)) : 0.0;
+    double min = self->stats_min, max = self->stats_max;
+    if (reset) {
+        self->stats_count = 0;
+        self->stats_mean = self->stats_m2 = 0.0;
+    }
+    os_unfair_lock_unlock(&self->lock);
+
+    if (count == 0) mean = min = max = NAN;
+    return Py_BuildValue("{s:K,s:d,s:d,s:d,s:d}", "count", (unsigned long long)count, "mean", mean, "stdev", stdev, "min", min, "max", max);
+}
+
+static PyObject* Pipeline_flicker(PipelineObject* self, PyObject* Py_UNUSED(ignored)) {
+    if (!self->has_flicker) {
+        PyErr_SetString(PyExc_RuntimeError, "Pipeline has no flicker stage.");
+        return NULL;
+    }
+
+    FlickerResult windows[PIPELINE_FLICKER_WINDOWS];
+    os_unfair_lock_lock(&self->lock);
+    int count = self->flicker_count;
+    for (int i = 0; i < count; i++) {
+        windows[i] = self->flicker_windows[(self->flicker_head + i) % PIPELINE_FLICKER_WINDOWS];
+    }
+    self->flicker_head = self->flicker_count = 0;
+    os_unfair_lock_unlock(&self->lock);
+
+    PyObject* list = PyList_New(count);
+    for (int i = 0; list && i < count; i++) {
+        PyObject* item = FlickerWindow_new(&windows[i]);
+        if (!item) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+static PyObject* Pipeline_get_samples(PipelineObject* self, void* closure) {
+    os_unfair_lock_lock(&self->lock);
+    uint64_t samples = self->samples;
+    os_unfair_lock_unlock(&self->lock);
+    return PyLong_FromUnsignedLongLong(samples);
+}
+
+static PyObject* Pipeline_get_emitted(PipelineObject* self, void* closure) {
+    os_unfair_lock_lock(&self->lock);
+    uint64_t emitted = self->emitted;
+    os_unfair_lock_unlock(&self->lock);
+    return PyLong_FromUnsignedLongLong(emitted);
+}
+
+static PyGetSetDef Pipeline_getset[] = {
+    {"samples", (getter)Pipeline_get_samples, NULL, "number of readings fed into the pipeline", NULL},
+    {"emitted", (getter)Pipeline_get_emitted, NULL, "number of readings that passed the deadband and reached the sinks", NULL},
+    {NULL}
+};
+
+static PyMethodDef Pipeline_methods[] = {
+    {"from_toml", (PyCFunction)Pipeline_from_toml, METH_O | METH_CLASS, PyDoc_STR("Build a Pipeline from a TOML document.")},
+    {"push", (PyCFunction)Pipeline_push, METH_VARARGS, PyDoc_STR("Feed one reading; return the processed value if it reached the sinks, else None.")},
+    {"extend", (PyCFunction)Pipeline_extend, METH_VARARGS, PyDoc_STR("Feed timestamp and value columns; return how many readings reached the sinks.")},
+    {"flush", (PyCFunction)Pipeline_flush, METH_NOARGS, PyDoc_STR("Write buffered recorder records, deliver the pending callback batch and send the partial uplink batch; raise OSError if a recorder or backlight write failed.")},
+    {"drain", (PyCFunction)Pipeline_drain, METH_VARARGS, PyDoc_STR("Remove up to max_samples readings (default all) from the ring sink as a SampleBatch.")},
+    {"history", (PyCFunction)(void(*)(void))Pipeline_history, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Return the ring sink readings with since_ns <= timestamp < until_ns as a SampleBatch.")},
+    {"stats", (PyCFunction)(void(*)(void))Pipeline_stats, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Return count, mean, stdev, min and max of the emitted readings, optionally resetting them.")},
+    {"flicker", (PyCFunction)Pipeline_flicker, METH_NOARGS, PyDoc_STR("Remove and return the FlickerWindows completed since the last call (at most the last 64).")},
+    {NULL}
+};
+
+static PyTypeObject PipelineType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.Pipeline",
+    .tp_basicsize = sizeof(PipelineObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Native calibrate, flicker, filter, deadband, stats and sink chain built from a spec",
+    .tp_methods = Pipeline_methods,
+    .tp_getset = Pipeline_getset,
+    .tp_dealloc = (destructor)Pipeline_dealloc,
+    .tp_init = (initproc)Pipeline_init,
+    .tp_new = Pipeline_new,
+};
+
+/* Scheduler: samples many sensors, each at its own interval, from one timer
+ * thread and a small worker pool. Due times sit on a hierarchical timer
+ * wheel: level l has WHEEL_SLOTS slots of WHEEL_SLOTS^l ticks each, entries
+ * cascade down a level as their slot comes around, and anything further out
+ * than the top level waits on the overflow list. Workers only take the GIL
+ * when a pipeline has a callback batch to deliver; entries removed while a
+ * worker holds them are parked on the graveyard until a later call can drop
+ * their source reference. */
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define SCHED_MIN_TICK_NS 10000
+
+enum { ENTRY_WAITING, ENTRY_READY, ENTRY_RUNNING };
+
+typedef struct SchedEntry {
+    struct SchedEntry* next;
+    struct SchedEntry** pprev;
+    PyObject* source;
+    PipelineObject* pipeline;
+    int64_t interval;
+    int64_t due;
+    uint64_t due_tick;
+    Py_ssize_t index;
+    int state;
+    int removed;
+    int replay;
+} SchedEntry;
 
 typedef struct {
     PyObject_HEAD
-    io_service_t service;
-    char service_name[128];
-} LightSensorObject;
+    pthread_mutex_t lock;
+    pthread_cond_t ready_cond;
+    pthread_cond_t timer_cond;
+    SchedEntry* wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    SchedEntry* overflow;
+    SchedEntry* ready;
+    SchedEntry** ready_tail;
+    SchedEntry* graveyard;
+    SchedEntry** entries;
+    Py_ssize_t count;
+    Py_ssize_t capacity;
+    int64_t tick_ns;
+    int64_t origin;
+    uint64_t now_tick;
+    pthread_t* threads;
+    int workers;
+    int running;
+    int joining;
+    int initialized;
+    uint64_t reads;
+    uint64_t errors;
+} SchedulerObject;
+
+static uint64_t sched_tick_of(const SchedulerObject* s, int64_t t) {
+    return (uint64_t)(t - s->origin + s->tick_ns - 1) / (uint64_t)s->tick_ns;
+}
+
+static void sched_link(SchedEntry** head, SchedEntry* e) {
+    e->next = *head;
+    if (e->next) e->next->pprev = &e->next;
+    e->pprev = head;
+    *head = e;
+}
+
+static void sched_unlink(SchedulerObject* s, SchedEntry* e) {
+    *e->pprev = e->next;
+    if (e->next) {
+        e->next->pprev = e->pprev;
+    } else if (e->state == ENTRY_READY) {
+        s->ready_tail = e->pprev;
+    }
+    e->next = NULL;
+    e->pprev = NULL;
+}
+
+static void sched_ready(SchedulerObject* s, SchedEntry* e) {
+    e->state = ENTRY_READY;
+    e->next = NULL;
+    e->pprev = s->ready_tail;
+    *s->ready_tail = e;
+    s->ready_tail = &e->next;
+}
+
+/* Files an entry under the slot its due tick falls in, or on the ready list
+ * once due. Returns 1 when the entry became ready. */
+static int sched_place(SchedulerObject* s, SchedEntry* e) {
+    uint64_t due = e->due_tick;
+    if (due <= s->now_tick) {
+        sched_ready(s, e);
+        return 1;
+    }
+
+    e->state = ENTRY_WAITING;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * (level + 1);
+        if ((due >> shift) == (s->now_tick >> shift)) {
+            sched_link(&s->wheel[level][(due >> (shift - WHEEL_BITS)) & WHEEL_MASK], e);
+            return 0;
+        }
+    }
+    sched_link(&s->overflow, e);
+    return 0;
+}
+
+static int sched_cascade(SchedulerObject* s, SchedEntry** head) {
+    SchedEntry* list = *head;
+    *head = NULL;
+    int ready = 0;
+    while (list) {
+        SchedEntry* e = list;
+        list = e->next;
+        ready |= sched_place(s, e);
+    }
+    return ready;
+}
+
+static int sched_advance(SchedulerObject* s) {
+    uint64_t now = ++s->now_tick;
+    int ready = 0;
+    if ((now & ((1ull << (WHEEL_BITS * WHEEL_LEVELS)) - 1)) == 0) {
+        ready |= sched_cascade(s, &s->overflow);
+    }
+    for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+        int shift = WHEEL_BITS * level;
+        if ((now & ((1ull << shift) - 1)) == 0) {
+            ready |= sched_cascade(s, &s->wheel[level][(now >> shift) & WHEEL_MASK]);
+        }
+    }
+    return ready | sched_cascade(s, &s->wheel[0][now & WHEEL_MASK]);
+}
+
+/* Moves the wheel straight to tick target and refiles every entry, instead
+ * of stepping through a long run of missed ticks, e.g. after stop(). */
+static int sched_jump(SchedulerObject* s, uint64_t target) {
+    SchedEntry* all = s->overflow;
+    s->overflow = NULL;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+            while (s->wheel[level][slot]) {
+                SchedEntry* e = s->wheel[level][slot];
+                sched_unlink(s, e);
+                sched_link(&all, e);
+            }
+        }
+    }
+    s->now_tick = target;
+    return sched_cascade(s, &all);
+}
+
+static void* sched_timer_main(void* arg) {
+    SchedulerObject* s = arg;
+    pthread_mutex_lock(&s->lock);
+    while (s->running) {
+        uint64_t target = (uint64_t)(monotonic_ns() - s->origin) / (uint64_t)s->tick_ns;
+        if (s->count == 0) {
+            if (s->now_tick < target) s->now_tick = target;
+            pthread_cond_wait(&s->timer_cond, &s->lock);
+            continue;
+        }
+
+        int ready = 0;
+        if (target > s->now_tick + WHEEL_SLOTS) ready = sched_jump(s, target);
+        while (s->now_tick < target) ready |= sched_advance(s);
+        if (ready) pthread_cond_broadcast(&s->ready_cond);
+
+        int64_t wait = s->origin + (int64_t)(s->now_tick + 1) * s->tick_ns - monotonic_ns();
+        if (wait > 0) {
+            struct timespec rel = {wait / 1000000000, wait % 1000000000};
+            pthread_cond_timedwait_relative_np(&s->timer_cond, &s->lock, &rel);
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+static void* sched_worker_main(void* arg) {
+    SchedulerObject* s = arg;
+    pthread_mutex_lock(&s->lock);
+    while (s->running) {
+        SchedEntry* e = s->ready;
+        if (!e) {
+            pthread_cond_wait(&s->ready_cond, &s->lock);
+            continue;
+        }
+        sched_unlink(s, e);
+        e->state = ENTRY_RUNNING;
+        pthread_mutex_unlock(&s->lock);
+
+        double value;
+        int64_t timestamp;
+        int ok;
+        if (e->replay) {
+            timestamp = monotonic_ns();
+            ok = ReplaySource_next((ReplaySourceObject*)e->source, &value);
+        } else {
+            float lux;
+            ok = LightSensor_read((LightSensorObject*)e->source, &lux, &timestamp) == LUX_OK;
+            value = lux;
+        }
+        if (ok && e->pipeline) ok = Pipeline_feed(e->pipeline, timestamp, value) >= 0;
+
+        pthread_mutex_lock(&s->lock);
+        if (ok) {
+            s->reads++;
+        } else {
+            s->errors++;
+        }
+        if (e->removed) {
+            sched_link(&s->graveyard, e);
+            continue;
+        }
+        e->due += e->interval;
+        if (e->due <= timestamp) e->due = timestamp + e->interval;
+        e->due_tick = sched_tick_of(s, e->due);
+        sched_place(s, e);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+/* Needs the GIL, and the entries must no longer be reachable from s. */
+static void sched_free_list(SchedEntry* list) {
+    while (list) {
+        SchedEntry* next = list->next;
+        Py_DECREF(list->source);
+        Py_XDECREF(list->pipeline);
+        PyMem_RawFree(list);
+        list = next;
+    }
+}
+
+static void Scheduler_collect(SchedulerObject* self) {
+    pthread_mutex_lock(&self->lock);
+    SchedEntry* graveyard = self->graveyard;
+    self->graveyard = NULL;
+    pthread_mutex_unlock(&self->lock);
+    sched_free_list(graveyard);
+}
+
+static void Scheduler_join(SchedulerObject* self) {
+    pthread_t* threads = self->threads;
+    int count = self->workers + 1;
+    if (!threads) return;
+    self->threads = NULL;
+    self->joining = 1;
+
+    pthread_mutex_lock(&self->lock);
+    self->running = 0;
+    pthread_cond_broadcast(&self->ready_cond);
+    pthread_cond_broadcast(&self->timer_cond);
+    pthread_mutex_unlock(&self->lock);
+
+    Py_BEGIN_ALLOW_THREADS
+    for (int i = 0; i < count; i++) pthread_join(threads[i], NULL);
+    Py_END_ALLOW_THREADS
+
+    PyMem_RawFree(threads);
+    self->joining = 0;
+}
+
+static void Scheduler_dealloc(SchedulerObject* self) {
+    if (self->initialized) {
+        Scheduler_join(self);
+        for (Py_ssize_t i = 0; i < self->count; i++) {
+            self->entries[i]->next = NULL;
+            sched_free_list(self->entries[i]);
+        }
+        sched_free_list(self->graveyard);
+        pthread_cond_destroy(&self->timer_cond);
+        pthread_cond_destroy(&self->ready_cond);
+        pthread_mutex_destroy(&self->lock);
+    }
+    PyMem_Free(self->entries);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int Scheduler_init(SchedulerObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"workers", "tick_ns", NULL};
+    int workers = 2;
+    long long tick = 1000000;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iL", kwlist, &workers, &tick)) return -1;
+
+    if (workers < 1) {
+        PyErr_SetString(PyExc_ValueError, "workers must be at least 1.");
+        return -1;
+    }
+    if (tick < SCHED_MIN_TICK_NS) {
+        PyErr_SetString(PyExc_ValueError, "tick_ns must be at least 10000.");
+        return -1;
+    }
+    if (self->threads || self->joining || self->count) {
+        PyErr_SetString(PyExc_RuntimeError, "Cannot reinitialize a Scheduler that has sensors or is running.");
+        return -1;
+    }
+
+    if (!self->initialized) {
+        pthread_mutex_init(&self->lock, NULL);
+        pthread_cond_init(&self->ready_cond, NULL);
+        pthread_cond_init(&self->timer_cond, NULL);
+        self->ready_tail = &self->ready;
+        self->initialized = 1;
+    }
+    self->workers = workers;
+    self->tick_ns = tick;
+    self->origin = monotonic_ns();
+    self->now_tick = 0;
+    return 0;
+}
+
+static PyObject* Scheduler_add(SchedulerObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"sensor", "interval_ns", "pipeline", NULL};
+    PyObject *sensor, *pipeline = Py_None;
+    long long interval;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OL|O", kwlist, &sensor, &interval, &pipeline)) return NULL;
+    if (check_initialized(self, self->initialized) < 0) return NULL;
+
+    int replay = PyObject_TypeCheck(sensor, &ReplaySourceType);
+    if (!replay && !PyObject_TypeCheck(sensor, &LightSensorType)) {
+        PyErr_SetString(PyExc_TypeError, "sensor must be a LightSensor or a ReplaySource.");
+        return NULL;
+    }
+    if (pipeline != Py_None && !PyObject_TypeCheck(pipeline, &PipelineType)) {
+        PyErr_SetString(PyExc_TypeError, "pipeline must be a Pipeline.");
+        return NULL;
+    }
+    if (replay && pipeline == Py_None) {
+        PyErr_SetString(PyExc_ValueError, "A ReplaySource needs a pipeline.");
+        return NULL;
+    }
+    if (interval < self->tick_ns) {
+        PyErr_SetString(PyExc_ValueError, "interval_ns must be at least tick_ns.");
+        return NULL;
+    }
+
+    if (self->count == self->capacity) {
+        Py_ssize_t capacity = self->capacity ? self->capacity * 2 : 16;
+        SchedEntry** entries = PyMem_Realloc(self->entries, capacity * sizeof(SchedEntry*));
+        if (!entries) return PyErr_NoMemory();
+        self->entries = entries;
+        self->capacity = capacity;
+    }
+
+    SchedEntry* e = PyMem_RawCalloc(1, sizeof(SchedEntry));
+    if (!e) return PyErr_NoMemory();
+    Py_INCREF(sensor);
+    e->source = sensor;
+    e->replay = replay;
+    if (pipeline != Py_None) {
+        Py_INCREF(pipeline);
+        e->pipeline = (PipelineObject*)pipeline;
+    }
+    e->interval = interval;
+    e->due = monotonic_ns();
+
+    pthread_mutex_lock(&self->lock);
+    e->due_tick = sched_tick_of(self, e->due);
+    e->index = self->count;
+    self->entries[self->count++] = e;
+    if (sched_place(self, e)) pthread_cond_signal(&self->ready_cond);
+    pthread_cond_signal(&self->timer_cond);
+    pthread_mutex_unlock(&self->lock);
+
+    Scheduler_collect(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Scheduler_remove(SchedulerObject* self, PyObject* sensor) {
+    SchedEntry* removed = NULL;
+    int found = 0;
+    if (check_initialized(self, self->initialized) < 0) return NULL;
+
+    pthread_mutex_lock(&self->lock);
+    for (Py_ssize_t i = self->count - 1; i >= 0; i--) {
+        SchedEntry* e = self->entries[i];
+        if (e->source != sensor) continue;
+        found = 1;
+        self->entries[i] = self->entries[--self->count];
+        self->entries[i]->index = i;
+        if (e->state == ENTRY_RUNNING) {
+            e->removed = 1;
+        } else {
+            sched_unlink(self, e);
+            sched_link(&removed, e);
+        }
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    sched_free_list(removed);
+    Scheduler_collect(self);
+    if (!found) {
+        PyErr_SetString(PyExc_ValueError, "Sensor is not scheduled.");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* Scheduler_start(SchedulerObject* self, PyObject* Py_UNUSED(ignored)) {
+    if (check_initialized(self, self->initialized) < 0) return NULL;
+    if (self->threads || self->joining) {
+        PyErr_SetString(PyExc_RuntimeError, "Scheduler is already running.");
+        return NULL;
+    }
+
+    pthread_t* threads = PyMem_RawCalloc(self->workers + 1, sizeof(pthread_t));
+    if (!threads) return PyErr_NoMemory();
+
+    self->running = 1;
+    self->threads = threads;
+    int started = 0;
+    for (; started <= self->workers; started++) {
+        void* (*routine)(void*) = started == 0 ? sched_timer_main : sched_worker_main;
+        if (pthread_create(&threads[started], NULL, routine, self) != 0) break;
+    }
+    if (started <= self->workers) {
+        int workers = self->workers;
+        self->workers = started - 1;
+        Scheduler_join(self);
+        self->workers = workers;
+        PyErr_SetString(PyExc_RuntimeError, "Could not start scheduler threads.");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* Scheduler_stop(SchedulerObject* self, PyObject* Py_UNUSED(ignored)) {
+    if (!self->initialized) Py_RETURN_NONE;
+    Scheduler_join(self);
+    Scheduler_collect(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Scheduler_get_running(SchedulerObject* self, void* closure) {
+    return PyBool_FromLong(self->threads != NULL);
+}
+
+static PyObject* Scheduler_get_reads(SchedulerObject* self, void* closure) {
+    if (!self->initialized) return PyLong_FromLong(0);
+    pthread_mutex_lock(&self->lock);
+    uint64_t reads = self->reads;
+    pthread_mutex_unlock(&self->lock);
+    return PyLong_FromUnsignedLongLong(reads);
+}
+
+static PyObject* Scheduler_get_errors(SchedulerObject* self, void* closure) {
+    if (!self->initialized) return PyLong_FromLong(0);
+    pthread_mutex_lock(&self->lock);
+    uint64_t errors = self->errors;
+    pthread_mutex_unlock(&self->lock);
+    return PyLong_FromUnsignedLongLong(errors);
+}
+
+static Py_ssize_t Scheduler_length(SchedulerObject* self) {
+    return self->count;
+}
+
+static PyGetSetDef Scheduler_getset[] = {
+    {"running", (getter)Scheduler_get_running, NULL, "whether the scheduler threads are running", NULL},
+    {"reads", (getter)Scheduler_get_reads, NULL, "number of successful scheduled reads", NULL},
+    {"errors", (getter)Scheduler_get_errors, NULL, "number of scheduled reads that failed", NULL},
+    {NULL}
+};
+
+static PyMethodDef Scheduler_methods[] = {
+    {"add", (PyCFunction)(void(*)(void))Scheduler_add, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Sample a sensor into its recording ring, and optionally a Pipeline, every interval_ns; a ReplaySource feeds only its pipeline.")},
+    {"remove", (PyCFunction)Scheduler_remove, METH_O, PyDoc_STR("Stop sampling a sensor or ReplaySource.")},
+    {"start", (PyCFunction)Scheduler_start, METH_NOARGS, PyDoc_STR("Start the timer thread and workers.")},
+    {"stop", (PyCFunction)Scheduler_stop, METH_NOARGS, PyDoc_STR("Stop the timer thread and workers and wait for them to exit.")},
+    {NULL}
+};
 
-typedef struct {
-    PyObject_HEAD
-    io_iterator_t iter;
-} LightSensorIterator;
+static PySequenceMethods Scheduler_as_sequence = {
+    .sq_length = (lenfunc)Scheduler_length,
+};
 
-static void LightSensor_dealloc(LightSensorObject* self) {
-    if (self->service != MACH_PORT_NULL) {
-        IOObjectRelease(self->service);
-        self->service = MACH_PORT_NULL;
+static PyTypeObject SchedulerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.Scheduler",
+    .tp_basicsize = sizeof(SchedulerObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Timer-wheel scheduler sampling many sensors from a shared worker pool",
+    .tp_methods = Scheduler_methods,
+    .tp_getset = Scheduler_getset,
+    .tp_as_sequence = &Scheduler_as_sequence,
+    .tp_dealloc = (destructor)Scheduler_dealloc,
+    .tp_init = (initproc)Scheduler_init,
+    .tp_new = PyType_GenericNew,
+};
+
+static PyObject* py_resample(PyObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"timestamps", "values", "interval_ns", "method", "max_gap_ns", NULL};
+    PyObject *ts_obj, *values_obj;
+    long long interval = 0, max_gap = 0;
+    const char* method = "linear";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOL|sL", kwlist, &ts_obj, &values_obj, &interval, &method, &max_gap)) {
+        return NULL;
     }
-    Py_TYPE(self)->tp_free((PyObject*)self);
-}
 
-static PyObject* LightSensor_get_current_lux(LightSensorObject* self, PyObject* Py_UNUSED(ignored)) {
-    if (!self->service) {
-        PyErr_SetString(PyExc_RuntimeError, "No valid sensor service.");
+    ResampleState state;
+    if (resample_state_init(&state, interval, max_gap, method) < 0) return NULL;
+
+    ColumnArg ts, vals;
+    if (ColumnArg_load_samples(ts_obj, values_obj, &ts, &vals) < 0) return NULL;
+
+    SampleBuf out = {0};
+    int rc;
+    Py_BEGIN_ALLOW_THREADS
+    rc = resample_columns(&state, &ts, &vals, &out);
+    if (rc == 0) rc = resample_flush(&state, &out);
+    Py_END_ALLOW_THREADS
+    ColumnArg_release(&ts);
+    ColumnArg_release(&vals);
+    if (rc < 0) {
+        set_resample_error(rc);
+        SampleBuf_clear(&out);
         return NULL;
     }
+    return SampleBatch_from_buf(&out);
+}
 
-    CFTypeRef luxValue = IORegistryEntryCreateCFProperty(self->service, CFSTR("CurrentLux"), kCFAllocatorDefault, 0);
-    if (!luxValue) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to get CurrentLux property.");
+static PyObject* py_list_sensors(PyObject* self, PyObject* args) {
+    CFMutableDictionaryRef matchingDict = IOServiceMatching("IOService");
+    if (!matchingDict) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to create matching dictionary.");
         return NULL;
     }
 
-    float lux = 0;
-    if (CFGetTypeID(luxValue) == CFNumberGetTypeID()) {
-        CFNumberGetValue((CFNumberRef)luxValue, kCFNumberFloatType, &lux);
-    } else {
-        CFRelease(luxValue);
-        PyErr_SetString(PyExc_RuntimeError, "CurrentLux is not a number.");
+    io_iterator_t iter;
+    kern_return_t kr = IOServiceGetMatchingServices(kIOMainPortDefault, matchingDict, &iter);
+    if (kr != KERN_SUCCESS || !iter) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to get matching services.");
         return NULL;
     }
 
-    CFRelease(luxValue);
-    return PyFloat_FromDouble(lux);
-}
+    LightSensorIterator* it = PyObject_New(LightSensorIterator, &LightSensorIteratorType);
+    if (!it) {
+        IOObjectRelease(iter);
+        return PyErr_NoMemory();
+    }
 
-static PyObject* LightSensor_repr(LightSensorObject* self) {
-    return PyUnicode_FromFormat("LightSensor('%s')", self->service_name);
+    it->iter = iter;
+    it->batch = NULL;
+    it->batch_size = it->batch_len = it->batch_pos = 0;
+    it->filling = 0;
+    return (PyObject*)it;
 }
 
-static int LightSensor_init(LightSensorObject* self, PyObject* args, PyObject* kwds) {
-    const char* name = NULL;
-    if (!PyArg_ParseTuple(args, "s", &name)) {
-        PyErr_SetString(PyExc_TypeError, "Expected service name as a string.");
-        return -1;
+static PyObject* py_find_sensor(PyObject* self, PyObject* args) {
+    PyObject* it = py_list_sensors(self, NULL);
+    if (!it) return NULL;
+
+    PyObject* first = PyIter_Next(it);
+    Py_DECREF(it);
+
+    if (!first) {
+        PyErr_SetString(PyExc_RuntimeError, "No ambient light sensor found.");
+        return NULL;
     }
 
-    CFMutableDictionaryRef matchingDict = IOServiceMatching("IOService");
-    if (!matchingDict) {
+    return first;
+}
+
+/* Walks the services matching `matching` one at a time and stops at the
+ * first that has a CurrentLux property, without the batches list_sensors()
+ * checks in parallel. Consumes matching. Returns MACH_PORT_NULL with no
+ * exception set when nothing matches. */
+static io_service_t open_matching_sensor(CFMutableDictionaryRef matching, char* name) {
+    if (!matching) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to create matching dictionary.");
-        return -1;
+        return MACH_PORT_NULL;
     }
-
     io_iterator_t iter;
-    kern_return_t kr = IOServiceGetMatchingServices(kIOMainPortDefault, matchingDict, &iter);
+    kern_return_t kr = IOServiceGetMatchingServices(kIOMainPortDefault, matching, &iter);
     if (kr != KERN_SUCCESS || !iter) {
         PyErr_SetString(PyExc_RuntimeError, "Failed to get matching services.");
-        return -1;
+        return MACH_PORT_NULL;
     }
 
-    io_service_t service = MACH_PORT_NULL;
-    io_service_t candidate = 0;
-    char serviceName[128];
-
-    while ((candidate = IOIteratorNext(iter))) {
-        kr = IORegistryEntryGetName(candidate, serviceName);
-        if (kr == KERN_SUCCESS && strcmp(serviceName, name) == 0) {
-            service = candidate;
-            break;
-        }
-        IOObjectRelease(candidate);
+    DiscoveryCandidate candidate = {0};
+    Py_BEGIN_ALLOW_THREADS
+    while ((candidate.service = IOIteratorNext(iter))) {
+        discovery_check(&candidate, 0);
+        if (candidate.is_sensor) break;
+        IOObjectRelease(candidate.service);
     }
+    Py_END_ALLOW_THREADS
     IOObjectRelease(iter);
 
-    if (service == MACH_PORT_NULL) {
-        PyErr_SetString(PyExc_RuntimeError, "Service not found.");
-        return -1;
+    if (candidate.service) snprintf(name, 128, "%s", candidate.name);
+    return candidate.service;
+}
+
+/* Opens one sensor for a one-shot read: by registry entry ID (an int) or
+ * service name (a str) with a single narrowed match, or the first sensor
+ * found when id is None. Like find_sensor(), only services with a
+ * CurrentLux property count. Fills name and returns the service, or
+ * MACH_PORT_NULL with an exception set. */
+static io_service_t open_sensor_once(PyObject* id, char* name) {
+    CFMutableDictionaryRef matching;
+    if (id == Py_None) {
+        matching = IOServiceMatching("IOService");
+    } else if (PyLong_Check(id)) {
+        uint64_t entry = PyLong_AsUnsignedLongLong(id);
+        if (entry == (uint64_t)-1 && PyErr_Occurred()) return MACH_PORT_NULL;
+        matching = IORegistryEntryIDMatching(entry);
+    } else if (PyUnicode_Check(id)) {
+        const char* service_name = PyUnicode_AsUTF8(id);
+        if (!service_name) return MACH_PORT_NULL;
+        matching = IOServiceNameMatching(service_name);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "id must be a registry entry ID or a service name.");
+        return MACH_PORT_NULL;
     }
 
-    if (self->service != MACH_PORT_NULL) {
-        IOObjectRelease(self->service);
+    io_service_t service = open_matching_sensor(matching, name);
+    if (service || PyErr_Occurred()) return service;
+    if (id == Py_None) {
+        PyErr_SetString(PyExc_RuntimeError, "No ambient light sensor found.");
+    } else {
+        PyErr_Format(PyExc_RuntimeError, "No ambient light sensor %R found.", id);
     }
+    return MACH_PORT_NULL;
+}
 
-    self->service = service;
-    snprintf(self->service_name, sizeof(self->service_name), "%s", name);
+static int read_once(PyObject* id, char* name, float* lux) {
+    io_service_t service = open_sensor_once(id, name);
+    if (!service) return -1;
+
+    LuxStatus status = read_current_lux(service, lux);
+    IOObjectRelease(service);
+    if (status != LUX_OK) {
+        PyErr_SetString(PyExc_RuntimeError, lux_status_messages[status]);
+        return -1;
+    }
     return 0;
 }
 
-static PyObject* LightSensor_get_name(LightSensorObject* self, void* closure) {
-    return PyUnicode_FromString(self->service_name);
+static PyObject* py_read_once(PyObject* self, PyObject* args) {
+    PyObject* id = Py_None;
+    if (!PyArg_ParseTuple(args, "|O", &id)) return NULL;
+
+    char name[128];
+    float lux;
+    if (read_once(id, name, &lux) < 0) return NULL;
+    return PyFloat_FromDouble(lux);
 }
 
-static PyGetSetDef LightSensor_getset[] = {
-    {"name", (getter)LightSensor_get_name, NULL, "service name of the ambient light sensor", NULL},
-    {NULL}
-};
+/* SensorPool: sensor identities resolved once in a parent process and handed
+ * to worker processes as picklable SensorDescriptor objects. A descriptor
+ * reopens its sensor with a single registry entry ID match, falling back to
+ * the service name if the ID is gone (entry IDs do not survive a reboot), and the opened sensor is cached for
+ * the rest of the process. The cache only holds sensors it opened itself,
+ * keyed by the registry entry ID actually opened. Mach ports do not survive
+ * fork(), so when the process id changes each cached sensor is reopened. */
+static PyObject* sensor_cache;
+static pid_t sensor_cache_pid;
 
-static PyMethodDef LightSensor_methods[] = {
-    {"get_current_lux", (PyCFunction)LightSensor_get_current_lux, METH_NOARGS, PyDoc_STR("Get the lux value of ambient light sensor.")},
-    {NULL}
-};
+typedef struct {
+    PyObject_HEAD
+    uint64_t registry_id;
+    char service_name[128];
+} SensorDescriptorObject;
 
-static void LightSensorIterator_dealloc(LightSensorIterator* self) {
-    if (self->iter) {
-        IOObjectRelease(self->iter);
+/* Opens a sensor by registry entry ID, or by service name when the ID is
+ * gone, and stores the ID of the entry actually opened in *resolved. */
+static io_service_t sensor_cache_open(uint64_t registry_id, const char* service_name, uint64_t* resolved) {
+    char name[128];
+    PyObject* id = PyLong_FromUnsignedLongLong(registry_id);
+    if (!id) return MACH_PORT_NULL;
+    io_service_t service = open_sensor_once(id, name);
+    Py_DECREF(id);
+    if (!service) {
+        PyErr_Clear();
+        PyObject* by_name = PyUnicode_FromString(service_name);
+        if (!by_name) return MACH_PORT_NULL;
+        service = open_sensor_once(by_name, name);
+        Py_DECREF(by_name);
+        if (!service) return MACH_PORT_NULL;
     }
-    Py_TYPE(self)->tp_free((PyObject*)self);
+    if (IORegistryEntryGetRegistryEntryID(service, resolved) != KERN_SUCCESS) *resolved = registry_id;
+    return service;
 }
 
-static PyObject* LightSensorIterator_next(LightSensorIterator* self) {
-    io_service_t service;
-    while ((service = IOIteratorNext(self->iter))) {
-        CFTypeRef luxValue = IORegistryEntryCreateCFProperty(service, CFSTR("CurrentLux"), kCFAllocatorDefault, 0);
-        if (luxValue) {
-            char serviceName[128];
-            kern_return_t kr = IORegistryEntryGetName(service, serviceName);
-            PyObject* sensor = NULL;
-
-            if (kr == KERN_SUCCESS) {
-                PyObject* args = PyTuple_Pack(1, PyUnicode_FromString(serviceName));
-                if (args) {
-                    sensor = PyObject_CallObject((PyObject*)&LightSensorType, args);
-                    Py_DECREF(args);
-                }
-            }
+static int sensor_cache_store(PyObject* cache, uint64_t registry_id, PyObject* sensor) {
+    PyObject* key = PyLong_FromUnsignedLongLong(registry_id);
+    if (!key) return -1;
+    int result = PyDict_SetItem(cache, key, sensor);
+    Py_DECREF(key);
+    return result;
+}
+
+/* Gives each sensor inherited across fork() a port of this process. The old
+ * ports are meaningless here and may alias ports of this process, so they
+ * are forgotten rather than released. A sensor that cannot be reopened is
+ * left without a service and dropped from the cache. */
+static PyObject* sensor_cache_reopen(PyObject* inherited) {
+    PyObject* cache = PyDict_New();
+    PyObject* key;
+    PyObject* value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(inherited, &pos, &key, &value)) {
+        LightSensorObject* sensor = (LightSensorObject*)value;
+        uint64_t entry;
+        io_service_t service = cache ? sensor_cache_open(PyLong_AsUnsignedLongLong(key), sensor->service_name, &entry) : MACH_PORT_NULL;
+        pthread_mutex_lock(&sensor->read_lock);
+        sensor->service = service;
+        sensor->reading = 0;
+        pthread_mutex_unlock(&sensor->read_lock);
+        if (service && sensor_cache_store(cache, entry, value) < 0) Py_CLEAR(cache);
+        if (cache) PyErr_Clear();
+    }
+    return cache;
+}
+
+static PyObject* sensor_cache_get(void) {
+    pid_t pid = getpid();
+    if (sensor_cache && sensor_cache_pid != pid) {
+        PyObject* inherited = sensor_cache;
+        sensor_cache = sensor_cache_reopen(inherited);
+        Py_DECREF(inherited);
+    } else if (!sensor_cache) {
+        sensor_cache = PyDict_New();
+    }
+    sensor_cache_pid = pid;
+    return sensor_cache;
+}
+
+static int sensor_cache_put(uint64_t registry_id, PyObject* sensor) {
+    PyObject* cache = sensor_cache_get();
+    return cache ? sensor_cache_store(cache, registry_id, sensor) : -1;
+}
+
+static PyObject* sensor_cache_lookup(PyObject* cache, uint64_t registry_id) {
+    PyObject* key = PyLong_FromUnsignedLongLong(registry_id);
+    if (!key) return NULL;
+    PyObject* sensor = PyDict_GetItemWithError(cache, key);
+    Py_DECREF(key);
+    Py_XINCREF(sensor);
+    return sensor;
+}
+
+static PyObject* SensorDescriptor_create(uint64_t registry_id, const char* name) {
+    SensorDescriptorObject* self = PyObject_New(SensorDescriptorObject, &SensorDescriptorType);
+    if (!self) return NULL;
+    self->registry_id = registry_id;
+    snprintf(self->service_name, sizeof(self->service_name), "%s", name);
+    return (PyObject*)self;
+}
+
+/* Describes sensor, and caches it for SensorDescriptor.open() when cache is
+ * set, which is only for sensors the caller opened itself. */
+static PyObject* SensorDescriptor_from_sensor(LightSensorObject* sensor, int cache) {
+    uint64_t entry;
+    if (!sensor->service || IORegistryEntryGetRegistryEntryID(sensor->service, &entry) != KERN_SUCCESS) {
+        PyErr_Format(PyExc_RuntimeError, "%s: %s", sensor->service_name, lux_status_messages[LUX_NO_SERVICE]);
+        return NULL;
+    }
+    if (cache && sensor_cache_put(entry, (PyObject*)sensor) < 0) return NULL;
+    return SensorDescriptor_create(entry, sensor->service_name);
+}
+
+static int SensorDescriptor_init(SensorDescriptorObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"name", "registry_id", NULL};
+    const char* name;
+    unsigned long long registry_id;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sK", kwlist, &name, &registry_id)) return -1;
+
+    self->registry_id = registry_id;
+    snprintf(self->service_name, sizeof(self->service_name), "%s", name);
+    return 0;
+}
 
-            CFRelease(luxValue);
+static PyObject* SensorDescriptor_open(SensorDescriptorObject* self, PyObject* Py_UNUSED(ignored)) {
+    PyObject* cache = sensor_cache_get();
+    if (!cache) return NULL;
+    PyObject* sensor = sensor_cache_lookup(cache, self->registry_id);
+    if (sensor || PyErr_Occurred()) return sensor;
+
+    uint64_t entry;
+    io_service_t service = sensor_cache_open(self->registry_id, self->service_name, &entry);
+    if (!service) return NULL;
+    if (entry != self->registry_id) {
+        sensor = sensor_cache_lookup(cache, entry);
+        if (sensor || PyErr_Occurred()) {
             IOObjectRelease(service);
-            return sensor ? sensor : PyErr_NoMemory();
+            return sensor;
         }
-
-        IOObjectRelease(service);
     }
 
-    PyErr_SetNone(PyExc_StopIteration);
-    return NULL;
+    sensor = LightSensor_from_service(service, self->service_name);
+    if (!sensor) return NULL;
+    if (sensor_cache_store(cache, entry, sensor) < 0) Py_CLEAR(sensor);
+    return sensor;
 }
 
-static PyObject* LightSensorIterator_iter(PyObject* self) {
-    Py_INCREF(self);
-    return self;
+static PyObject* SensorDescriptor_reduce(SensorDescriptorObject* self, PyObject* Py_UNUSED(ignored)) {
+    return Py_BuildValue("(O(sK))", Py_TYPE(self), self->service_name, (unsigned long long)self->registry_id);
 }
 
-static PyTypeObject LightSensorIteratorType = {
+static PyObject* SensorDescriptor_repr(SensorDescriptorObject* self) {
+    char id[32];
+    snprintf(id, sizeof(id), "0x%llx", (unsigned long long)self->registry_id);
+    return PyUnicode_FromFormat("SensorDescriptor('%s', %s)", self->service_name, id);
+}
+
+static PyObject* SensorDescriptor_richcompare(PyObject* a, PyObject* b, int op) {
+    if (!PyObject_TypeCheck(b, &SensorDescriptorType) || (op != Py_EQ && op != Py_NE)) Py_RETURN_NOTIMPLEMENTED;
+    SensorDescriptorObject* x = (SensorDescriptorObject*)a;
+    SensorDescriptorObject* y = (SensorDescriptorObject*)b;
+    int equal = x->registry_id == y->registry_id && strcmp(x->service_name, y->service_name) == 0;
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
+static Py_hash_t SensorDescriptor_hash(SensorDescriptorObject* self) {
+    Py_hash_t hash = (Py_hash_t)(self->registry_id ^ hash_name(self->service_name));
+    return hash == -1 ? -2 : hash;
+}
+
+static PyObject* SensorDescriptor_get_name(SensorDescriptorObject* self, void* closure) {
+    return PyUnicode_FromString(self->service_name);
+}
+
+static PyObject* SensorDescriptor_get_registry_id(SensorDescriptorObject* self, void* closure) {
+    return PyLong_FromUnsignedLongLong(self->registry_id);
+}
+
+static PyGetSetDef SensorDescriptor_getset[] = {
+    {"name", (getter)SensorDescriptor_get_name, NULL, "service name of the sensor", NULL},
+    {"registry_id", (getter)SensorDescriptor_get_registry_id, NULL, "IORegistry entry ID of the sensor service", NULL},
+    {NULL}
+};
+
+static PyMethodDef SensorDescriptor_methods[] = {
+    {"open", (PyCFunction)SensorDescriptor_open, METH_NOARGS, PyDoc_STR("Return the LightSensor for this descriptor, opened once per process and cached.")},
+    {"__reduce__", (PyCFunction)SensorDescriptor_reduce, METH_NOARGS, NULL},
+    {NULL}
+};
+
+static PyTypeObject SensorDescriptorType = {
     PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "_macals._LightSensorIterator",
-    .tp_basicsize = sizeof(LightSensorIterator),
+    .tp_name = "_macals.SensorDescriptor",
+    .tp_basicsize = sizeof(SensorDescriptorObject),
     .tp_flags = Py_TPFLAGS_DEFAULT,
-    .tp_doc = "Iterator over LightSensor objects (internal use only)",
-    .tp_iter = LightSensorIterator_iter,
-    .tp_iternext = (iternextfunc)LightSensorIterator_next,
-    .tp_dealloc = (destructor)LightSensorIterator_dealloc,
+    .tp_doc = "Picklable identity of a sensor that reopens it in O(1)",
+    .tp_methods = SensorDescriptor_methods,
+    .tp_getset = SensorDescriptor_getset,
+    .tp_repr = (reprfunc)SensorDescriptor_repr,
+    .tp_richcompare = SensorDescriptor_richcompare,
+    .tp_hash = (hashfunc)SensorDescriptor_hash,
+    .tp_init = (initproc)SensorDescriptor_init,
+    .tp_new = PyType_GenericNew,
 };
 
-static PyObject* py_list_sensors(PyObject* self, PyObject* args) {
-    CFMutableDictionaryRef matchingDict = IOServiceMatching("IOService");
-    if (!matchingDict) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to create matching dictionary.");
-        return NULL;
+typedef struct {
+    PyObject_HEAD
+    PyObject* descriptors;
+} SensorPoolObject;
+
+static void SensorPool_dealloc(SensorPoolObject* self) {
+    Py_XDECREF(self->descriptors);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/* Accepts SensorDescriptor, LightSensor and service name items, or every
+ * sensor found when sensors is None. Names are resolved in one registry walk
+ * and sensors opened here are cached for SensorDescriptor.open(); LightSensor
+ * items belong to the caller and are only described. */
+static int SensorPool_init(SensorPoolObject* self, PyObject* args, PyObject* kwds) {
+    static char* kwlist[] = {"sensors", NULL};
+    PyObject* sensors = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &sensors)) return -1;
+
+    PyObject* items;
+    if (sensors == Py_None) {
+        PyObject* it = py_list_sensors(NULL, NULL);
+        items = it ? PySequence_List(it) : NULL;
+        Py_XDECREF(it);
+    } else {
+        items = PySequence_List(sensors);
     }
+    if (!items) return -1;
 
-    io_iterator_t iter;
-    kern_return_t kr = IOServiceGetMatchingServices(kIOMainPortDefault, matchingDict, &iter);
-    if (kr != KERN_SUCCESS || !iter) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to get matching services.");
-        return NULL;
+    Py_ssize_t count = PyList_GET_SIZE(items);
+    PyObject* names = PyList_New(0);
+    PyObject* opened = NULL;
+    PyObject* descriptors = NULL;
+    if (!names) goto done;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject* item = PyList_GET_ITEM(items, i);
+        if (PyUnicode_Check(item)) {
+            if (PyList_Append(names, item) < 0) goto done;
+        } else if (!PyObject_TypeCheck(item, &SensorDescriptorType) && !PyObject_TypeCheck(item, &LightSensorType)) {
+            PyErr_SetString(PyExc_TypeError, "SensorPool expects service names, LightSensor or SensorDescriptor objects.");
+            goto done;
+        }
     }
+    if (PyList_GET_SIZE(names) && !(opened = LightSensor_open_many(NULL, names))) goto done;
 
-    LightSensorIterator* it = PyObject_New(LightSensorIterator, &LightSensorIteratorType);
-    if (!it) {
-        IOObjectRelease(iter);
-        return PyErr_NoMemory();
+    descriptors = PyTuple_New(count);
+    for (Py_ssize_t i = 0, n = 0; descriptors && i < count; i++) {
+        PyObject* item = PyList_GET_ITEM(items, i);
+        PyObject* descriptor;
+        if (PyObject_TypeCheck(item, &SensorDescriptorType)) {
+            Py_INCREF(item);
+            descriptor = item;
+        } else {
+            LightSensorObject* sensor = (LightSensorObject*)(PyUnicode_Check(item) ? PyList_GET_ITEM(opened, n++) : item);
+            descriptor = SensorDescriptor_from_sensor(sensor, sensors == Py_None || PyUnicode_Check(item));
+        }
+        if (!descriptor) {
+            Py_CLEAR(descriptors);
+            break;
+        }
+        PyTuple_SET_ITEM(descriptors, i, descriptor);
     }
+    if (descriptors) Py_XSETREF(self->descriptors, descriptors);
 
-    it->iter = iter;
-    return (PyObject*)it;
+done:
+    Py_XDECREF(opened);
+    Py_XDECREF(names);
+    Py_DECREF(items);
+    return descriptors ? 0 : -1;
 }
 
-static PyObject* py_find_sensor(PyObject* self, PyObject* args) {
-    PyObject* it = py_list_sensors(self, NULL);
-    if (!it) return NULL;
+static PyObject* SensorPool_reduce(SensorPoolObject* self, PyObject* Py_UNUSED(ignored)) {
+    return Py_BuildValue("(O(O))", Py_TYPE(self), self->descriptors ? self->descriptors : Py_None);
+}
 
-    PyObject* first = PyIter_Next(it);
-    Py_DECREF(it);
+static PyObject* SensorPool_repr(SensorPoolObject* self) {
+    return PyUnicode_FromFormat("SensorPool(%R)", self->descriptors ? self->descriptors : Py_None);
+}
 
-    if (!first) {
-        PyErr_SetString(PyExc_RuntimeError, "No ambient light sensor found.");
+static PyObject* SensorPool_get_descriptors(SensorPoolObject* self, void* closure) {
+    if (!self->descriptors) return PyTuple_New(0);
+    Py_INCREF(self->descriptors);
+    return self->descriptors;
+}
+
+static Py_ssize_t SensorPool_length(SensorPoolObject* self) {
+    return self->descriptors ? PyTuple_GET_SIZE(self->descriptors) : 0;
+}
+
+static PyObject* SensorPool_item(SensorPoolObject* self, Py_ssize_t i) {
+    if (i < 0 || i >= SensorPool_length(self)) {
+        PyErr_SetString(PyExc_IndexError, "SensorPool index out of range");
         return NULL;
     }
+    PyObject* descriptor = PyTuple_GET_ITEM(self->descriptors, i);
+    Py_INCREF(descriptor);
+    return descriptor;
+}
 
-    return first;
+static PyGetSetDef SensorPool_getset[] = {
+    {"descriptors", (getter)SensorPool_get_descriptors, NULL, "tuple of the SensorDescriptor objects in the pool", NULL},
+    {NULL}
+};
+
+static PyMethodDef SensorPool_methods[] = {
+    {"__reduce__", (PyCFunction)SensorPool_reduce, METH_NOARGS, NULL},
+    {NULL}
+};
+
+static PySequenceMethods SensorPool_as_sequence = {
+    .sq_length = (lenfunc)SensorPool_length,
+    .sq_item = (ssizeargfunc)SensorPool_item,
+};
+
+static PyTypeObject SensorPoolType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_macals.SensorPool",
+    .tp_basicsize = sizeof(SensorPoolObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Sensors resolved once and handed to worker processes as SensorDescriptor objects",
+    .tp_methods = SensorPool_methods,
+    .tp_getset = SensorPool_getset,
+    .tp_as_sequence = &SensorPool_as_sequence,
+    .tp_repr = (reprfunc)SensorPool_repr,
+    .tp_dealloc = (destructor)SensorPool_dealloc,
+    .tp_init = (initproc)SensorPool_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* Parses an --id value: a registry entry ID in decimal or 0x hex, otherwise a
+ * service name. */
+static PyObject* parse_sensor_id(const char* value) {
+    char* end;
+    errno = 0;
+    unsigned long long entry = strtoull(value, &end, 0);
+    if (*value && !*end && !errno && value[0] != '-') return PyLong_FromUnsignedLongLong(entry);
+    return PyUnicode_FromString(value);
 }
 
 static PyObject* py_main(PyObject* self, PyObject* args) {
+    PyObject* argv = Py_None;
+    if (!PyArg_ParseTuple(args, "|O", &argv)) return NULL;
+
+    int once = 0;
+    PyObject* id = NULL;
+    if (argv != Py_None) {
+        PyObject* seq = PySequence_Fast(argv, "argv must be a sequence of strings.");
+        if (!seq) return NULL;
+
+        Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+        for (Py_ssize_t i = 0; i < n; i++) {
+            const char* arg = PyUnicode_Check(PySequence_Fast_GET_ITEM(seq, i)) ? PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i)) : NULL;
+            const char* value = NULL;
+            if (arg && strcmp(arg, "--once") == 0) {
+                once = 1;
+                continue;
+            }
+            if (arg && strcmp(arg, "--id") == 0 && i + 1 < n && PyUnicode_Check(PySequence_Fast_GET_ITEM(seq, i + 1))) {
+                value = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, ++i));
+            } else if (arg && strncmp(arg, "--id=", 5) == 0) {
+                value = arg + 5;
+            }
+            if (!value || id) {
+                Py_DECREF(seq);
+                Py_XDECREF(id);
+                PyErr_SetString(PyExc_SystemExit, "usage: python -m macals [--once] [--id ID]");
+                return NULL;
+            }
+            id = parse_sensor_id(value);
+            if (!id) {
+                Py_DECREF(seq);
+                return NULL;
+            }
+            once = 1;
+        }
+        Py_DECREF(seq);
+    }
+
+    if (once) {
+        char name[128];
+        float lux;
+        int rc = read_once(id ? id : Py_None, name, &lux);
+        Py_XDECREF(id);
+        if (rc < 0) return NULL;
+        printf("%s: %.1f lux\n", name, lux);
+        Py_RETURN_NONE;
+    }
+
     PyObject* it = py_list_sensors(self, NULL);
     if (!it) return NULL;
 
     PyObject* sensor;
     while ((sensor = PyIter_Next(it))) {
-        PyObject* name_attr = PyObject_GetAttrString(sensor, "name");
-        PyObject* lux_attr = PyObject_CallMethod(sensor, "get_current_lux", NULL);
-        if (name_attr && lux_attr) {
-            printf("%s: %.1f lux\n", PyUnicode_AsUTF8(name_attr), PyFloat_AsDouble(lux_attr));
+        LightSensorObject* s = (LightSensorObject*)sensor;
+        float lux;
+        if (read_current_lux(s->service, &lux) == LUX_OK) {
+            printf("%s: %.1f lux\n", s->service_name, lux);
         }
-        Py_XDECREF(name_attr);
-        Py_XDECREF(lux_attr);
         Py_DECREF(sensor);
     }
 
     Py_DECREF(it);
+    if (PyErr_Occurred()) return NULL;
     Py_RETURN_NONE;
 }
 
 static PyMethodDef module_methods[] = {
     {"find_sensor", py_find_sensor, METH_NOARGS, PyDoc_STR("Return the first ambient light sensor as a LightSensor object.")},
     {"list_sensors", py_list_sensors, METH_NOARGS, PyDoc_STR("Return an iterator over LightSensor objects.")},
-    {"main", py_main, METH_NOARGS, PyDoc_STR("Print names and lux values of all sensors.")},
+    {"main", py_main, METH_VARARGS, PyDoc_STR("Print names and lux values of all sensors, or of one with --once and --id ID in argv.")},
+    {"read_once", py_read_once, METH_VARARGS, PyDoc_STR("Read one sensor by registry entry ID or service name (default the first found) and return its lux value.")},
+    {"resample", (PyCFunction)(void(*)(void))py_resample, METH_VARARGS | METH_KEYWORDS, PyDoc_STR("Resample (timestamps, values) onto a fixed-rate grid and return a SampleBatch.")},
     {NULL, NULL, 0, NULL}
 };
 
@@ -268,7 +6056,7 @@ static PyTypeObject LightSensorType = {
     .tp_dealloc = (destructor)LightSensor_dealloc,
     .tp_repr = (reprfunc)LightSensor_repr,
     .tp_init = (initproc)LightSensor_init,
-    .tp_new = PyType_GenericNew,
+    .tp_new = LightSensor_new,
 };
 
 static struct PyModuleDef macalsmodule = {
@@ -282,6 +6070,29 @@ static struct PyModuleDef macalsmodule = {
 PyMODINIT_FUNC PyInit__macals(void) {
     if (PyType_Ready(&LightSensorType) < 0) return NULL;
     if (PyType_Ready(&LightSensorIteratorType) < 0) return NULL;
+    if (PyType_Ready(&SampleColumnType) < 0) return NULL;
+    if (PyType_Ready(&SampleBatchType) < 0) return NULL;
+    if (PyType_Ready(&ResamplerType) < 0) return NULL;
+    if (PyType_Ready(&FlickerAnalyzerType) < 0) return NULL;
+    if (PyType_Ready(&ChangeDetectorType) < 0) return NULL;
+    if (PyType_Ready(&RuleSetType) < 0) return NULL;
+    if (PyType_Ready(&BacklightControllerType) < 0) return NULL;
+    if (PyType_Ready(&SensorGroupType) < 0) return NULL;
+    if (PyType_Ready(&SchedulerType) < 0) return NULL;
+    if (PyType_Ready(&ReplaySourceType) < 0) return NULL;
+    if (PyType_Ready(&PipelineType) < 0) return NULL;
+    if (PyType_Ready(&UplinkType) < 0) return NULL;
+    if (PyType_Ready(&SensorDescriptorType) < 0) return NULL;
+    if (PyType_Ready(&SensorPoolType) < 0) return NULL;
+
+    FlickerWindowType = PyStructSequence_NewType(&FlickerWindow_desc);
+    if (!FlickerWindowType) return NULL;
+
+    SensorEventType = PyStructSequence_NewType(&SensorEvent_desc);
+    if (!SensorEventType) return NULL;
+
+    RuleEventType = PyStructSequence_NewType(&RuleEvent_desc);
+    if (!RuleEventType) return NULL;
 
     PyObject* m = PyModule_Create(&macalsmodule);
     if (!m) return NULL;
@@ -289,5 +6100,53 @@ PyMODINIT_FUNC PyInit__macals(void) {
     Py_INCREF(&LightSensorType);
     PyModule_AddObject(m, "LightSensor", (PyObject*)&LightSensorType);
 
+    Py_INCREF(&SampleBatchType);
+    PyModule_AddObject(m, "SampleBatch", (PyObject*)&SampleBatchType);
+
+    Py_INCREF(&ResamplerType);
+    PyModule_AddObject(m, "Resampler", (PyObject*)&ResamplerType);
+
+    Py_INCREF(&FlickerAnalyzerType);
+    PyModule_AddObject(m, "FlickerAnalyzer", (PyObject*)&FlickerAnalyzerType);
+
+    Py_INCREF(FlickerWindowType);
+    PyModule_AddObject(m, "FlickerWindow", (PyObject*)FlickerWindowType);
+
+    Py_INCREF(&ChangeDetectorType);
+    PyModule_AddObject(m, "ChangeDetector", (PyObject*)&ChangeDetectorType);
+
+    Py_INCREF(SensorEventType);
+    PyModule_AddObject(m, "SensorEvent", (PyObject*)SensorEventType);
+
+    Py_INCREF(&RuleSetType);
+    PyModule_AddObject(m, "RuleSet", (PyObject*)&RuleSetType);
+
+    Py_INCREF(RuleEventType);
+    PyModule_AddObject(m, "RuleEvent", (PyObject*)RuleEventType);
+
+    Py_INCREF(&BacklightControllerType);
+    PyModule_AddObject(m, "BacklightController", (PyObject*)&BacklightControllerType);
+
+    Py_INCREF(&SensorGroupType);
+    PyModule_AddObject(m, "SensorGroup", (PyObject*)&SensorGroupType);
+
+    Py_INCREF(&SchedulerType);
+    PyModule_AddObject(m, "Scheduler", (PyObject*)&SchedulerType);
+
+    Py_INCREF(&ReplaySourceType);
+    PyModule_AddObject(m, "ReplaySource", (PyObject*)&ReplaySourceType);
+
+    Py_INCREF(&PipelineType);
+    PyModule_AddObject(m, "Pipeline", (PyObject*)&PipelineType);
+
+    Py_INCREF(&UplinkType);
+    PyModule_AddObject(m, "Uplink", (PyObject*)&UplinkType);
+
+    Py_INCREF(&SensorDescriptorType);
+    PyModule_AddObject(m, "SensorDescriptor", (PyObject*)&SensorDescriptorType);
+
+    Py_INCREF(&SensorPoolType);
+    PyModule_AddObject(m, "SensorPool", (PyObject*)&SensorPoolType);
+
     return m;
 }
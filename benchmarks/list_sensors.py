@@ -0,0 +1,30 @@
+"""Times sensor discovery: a full list_sensors() walk and find_sensor().
+
+Usage: python benchmarks/list_sensors.py [runs]
+"""
+import sys
+import time
+
+from macals import find_sensor
+from macals import list_sensors
+
+
+def best_of(runs, function):
+    best = float('inf')
+    for _ in range(runs):
+        start = time.perf_counter()
+        result = function()
+        best = min(best, time.perf_counter() - start)
+    return best, result
+
+
+def main():
+    runs = int(sys.argv[1]) if len(sys.argv) > 1 else 5
+    elapsed, sensors = best_of(runs, lambda: list(list_sensors()))
+    print('%-28s %8.1f ms  (%d sensors)' % ('list(list_sensors())', elapsed * 1000, len(sensors)))
+    elapsed, _ = best_of(runs, find_sensor)
+    print('%-28s %8.1f ms' % ('find_sensor()', elapsed * 1000))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,36 @@
+"""Times `python -m macals --once` against a full `python -m macals` run.
+
+Usage: python benchmarks/once.py [runs]
+"""
+import subprocess
+import sys
+import time
+
+from macals import find_sensor
+
+
+def best_of(runs, *args):
+    command = [sys.executable, '-m', 'macals', *args]
+    best = float('inf')
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def main():
+    runs = int(sys.argv[1]) if len(sys.argv) > 1 else 10
+    sensor = find_sensor()
+    cases = [
+        ('python -m macals', ()),
+        ('python -m macals --once', ('--once',)),
+        ('python -m macals --once --id %s' % sensor.name, ('--once', '--id', sensor.name)),
+        ('python -m macals --once --id %#x' % sensor.registry_id, ('--once', '--id', hex(sensor.registry_id))),
+    ]
+    for label, args in cases:
+        print('%-48s %8.1f ms' % (label, best_of(runs, *args) * 1000))
+
+
+if __name__ == '__main__':
+    main()
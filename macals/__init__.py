@@ -1,3 +1,22 @@
+from _macals import BacklightController
+from _macals import ChangeDetector
+from _macals import FlickerAnalyzer
+from _macals import FlickerWindow
 from _macals import LightSensor
+from _macals import Pipeline
+from _macals import ReplaySource
+from _macals import Resampler
+from _macals import RuleEvent
+from _macals import RuleSet
+from _macals import SampleBatch
+from _macals import Scheduler
+from _macals import SensorDescriptor
+from _macals import SensorEvent
+from _macals import SensorGroup
+from _macals import SensorPool
+from _macals import Uplink
 from _macals import find_sensor
 from _macals import list_sensors
+from _macals import main
+from _macals import read_once
+from _macals import resample
@@ -0,0 +1,66 @@
+import unittest
+
+from macals import find_sensor
+
+try:
+    SENSOR = find_sensor()
+except RuntimeError:
+    SENSOR = None
+
+
+@unittest.skipUnless(SENSOR, 'needs an ambient light sensor')
+class AcquireTest(unittest.TestCase):
+    def setUp(self):
+        SENSOR.record(4)
+        self.addCleanup(SENSOR.record, 0)
+
+    def read(self, count):
+        for _ in range(count):
+            SENSOR.get_current_lux()
+
+    def test_acquire_and_release(self):
+        self.assertEqual(SENSOR.acquire(), ())
+        self.read(3)
+        self.assertEqual(SENSOR.pending, 3)
+        (segment,) = SENSOR.acquire()
+        self.assertEqual(len(segment), 3)
+        SENSOR.release(3)
+        self.assertEqual(SENSOR.pending, 0)
+        self.assertEqual(SENSOR.acquire(), ())
+
+    def test_wrapped_region_is_two_segments(self):
+        self.read(3)
+        SENSOR.drain()
+        self.read(3)
+        first, second = SENSOR.acquire()
+        self.assertEqual((len(first), len(second)), (1, 2))
+        self.assertLess(first.timestamps[0], second.timestamps[0])
+        SENSOR.release(3)
+
+    def test_partial_release_keeps_the_rest_acquired(self):
+        self.read(4)
+        (segment,) = SENSOR.acquire()
+        kept = list(segment.timestamps)[2:]
+        SENSOR.release(2)
+        self.assertEqual(SENSOR.pending, 2)
+        with self.assertRaises(BufferError):
+            SENSOR.drain()
+        self.read(3)
+        self.assertEqual(SENSOR.pending, 4)
+        self.assertEqual(SENSOR.dropped, 1)
+        first, second = SENSOR.acquire()
+        self.assertEqual(list(first.timestamps), kept)
+        SENSOR.release(4)
+
+    def test_reacquire_does_not_shrink_the_lease(self):
+        self.read(3)
+        SENSOR.acquire()
+        SENSOR.acquire(1)
+        with self.assertRaises(ValueError):
+            SENSOR.release(4)
+        SENSOR.release(3)
+        self.assertEqual(SENSOR.pending, 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
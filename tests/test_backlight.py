@@ -0,0 +1,145 @@
+import math
+import os
+import tempfile
+import time
+import unittest
+
+from macals import BacklightController
+from macals import Pipeline
+from macals import ReplaySource
+from macals import Scheduler
+
+CURVE = [(0, 0.1), (9, 0.5), (999, 1.0)]
+
+
+class BacklightControllerTest(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.addCleanup(self.tmp.cleanup)
+
+    def backlight_dir(self, max_brightness=200):
+        path = os.path.join(self.tmp.name, 'backlight')
+        os.mkdir(path)
+        with open(os.path.join(path, 'max_brightness'), 'w') as f:
+            f.write('%d\n' % max_brightness)
+        with open(os.path.join(path, 'brightness'), 'w') as f:
+            f.write('0\n')
+        return path
+
+    def read_brightness(self, path):
+        with open(os.path.join(path, 'brightness')) as f:
+            return int(f.read())
+
+    def test_curve_interpolation(self):
+        written = []
+        controller = BacklightController(written.append, CURVE, max_brightness=1000)
+        self.assertEqual(controller.update(0.0), 100)
+        self.assertEqual(controller.update(-5.0), 100)
+        self.assertEqual(controller.update(9.0), 500)
+        self.assertEqual(controller.update(999.0), 1000)
+        self.assertEqual(controller.update(1e6), 1000)
+        fraction = 0.5 + 0.5 * (math.log10(100) - 1) / (3 - 1)
+        self.assertEqual(controller.update(99.0), round(fraction * 1000))
+        self.assertEqual(written, [100, 500, 1000, round(fraction * 1000)])
+
+    def test_directory_sink(self):
+        path = self.backlight_dir()
+        controller = BacklightController(path, CURVE)
+        self.assertEqual(controller.update(9.0), 100)
+        self.assertEqual(self.read_brightness(path), 100)
+        self.assertEqual(controller.update(999.0), 200)
+        self.assertEqual(self.read_brightness(path), 200)
+        self.assertEqual(controller.brightness, 200)
+
+    def test_file_sink_is_rewritten(self):
+        path = os.path.join(self.tmp.name, 'brightness')
+        with open(path, 'w') as f:
+            f.write('12345\n')
+        controller = BacklightController(path, CURVE, max_brightness=100)
+        controller.update(0.0)
+        with open(path) as f:
+            self.assertEqual(f.read(), '10\n')
+
+    def test_hysteresis(self):
+        written = []
+        controller = BacklightController(written.append, [(0, 0.0), (999, 1.0)], max_brightness=300, hysteresis=5)
+        controller.update(0.0)
+        self.assertEqual(controller.update(0.03), 0)
+        self.assertEqual(controller.update(0.08), 0)
+        self.assertGreaterEqual(controller.update(0.2), 5)
+        self.assertEqual(len(written), 2)
+        self.assertEqual(controller.writes, 2)
+
+    def test_smoothing(self):
+        written = []
+        controller = BacklightController(written.append, [(0, 0.0), (999, 1.0)], max_brightness=1000, smoothing_ns=1_000_000_000)
+        controller.update(0.0, 1)
+        self.assertEqual(controller.update(999.0, 1), 0)
+        self.assertEqual(controller.update(999.0, 1 + 1_000_000_000), round(1000 * (1 - math.exp(-1))))
+        self.assertEqual(len(written), 2)
+
+    def test_latency_counters(self):
+        controller = BacklightController(lambda brightness: None, CURVE)
+        self.assertEqual(controller.writes, 0)
+        self.assertIsNone(controller.brightness)
+        controller.update(0.0)
+        controller.update(999.0)
+        self.assertEqual(controller.writes, 2)
+        self.assertGreater(controller.last_latency_ns, 0)
+        self.assertGreaterEqual(controller.max_latency_ns, controller.last_latency_ns)
+        self.assertGreater(controller.mean_latency_ns, 0)
+
+    def test_bad_curves(self):
+        for curve in ([], [(10, 0.5), (5, 0.6)], [(0, 1.5)], [(-1, 0.5)], [(0, 0.1), (0, 0.2)]):
+            with self.assertRaises(ValueError):
+                BacklightController(lambda brightness: None, curve)
+        with self.assertRaises(TypeError):
+            BacklightController(lambda brightness: None, [(0,)])
+
+    def test_uninitialized(self):
+        controller = BacklightController.__new__(BacklightController)
+        with self.assertRaises(RuntimeError):
+            controller.update(1.0)
+        with self.assertRaises(RuntimeError):
+            controller.step()
+        with self.assertRaises(OSError):
+            controller.__init__(os.path.join(self.tmp.name, 'missing', 'brightness'), CURVE)
+        with self.assertRaises(RuntimeError):
+            controller.update(1.0)
+        controller.__init__(lambda brightness: None, CURVE)
+        self.assertEqual(controller.update(0.0), 10)
+        with self.assertRaises(RuntimeError):
+            controller.__init__(lambda brightness: None, CURVE)
+
+    def test_pipeline_sink(self):
+        path = self.backlight_dir(max_brightness=100)
+        controller = BacklightController(path, CURVE)
+        pipeline = Pipeline({'calibrate': {'gain': 10.0}, 'sinks': [{'type': 'backlight', 'controller': controller}]})
+        pipeline.extend([1, 2], [0.0, 99.9])
+        pipeline.flush()
+        self.assertEqual(self.read_brightness(path), 100)
+        self.assertEqual(controller.writes, 2)
+        with self.assertRaises(ValueError):
+            Pipeline({'sinks': [{'type': 'backlight', 'controller': BacklightController(print, CURVE)}]})
+        with self.assertRaises(TypeError):
+            Pipeline({'sinks': [{'type': 'backlight'}]})
+
+    def test_scheduled_loop(self):
+        path = self.backlight_dir(max_brightness=100)
+        controller = BacklightController(path, CURVE)
+        pipeline = Pipeline({'sinks': [{'type': 'backlight', 'controller': controller}]})
+        scheduler = Scheduler(workers=1, tick_ns=100_000)
+        scheduler.add(ReplaySource([0.0, 999.0], loop=False), 1_000_000, pipeline=pipeline)
+        scheduler.start()
+        try:
+            deadline = time.monotonic() + 5
+            while controller.writes < 2 and time.monotonic() < deadline:
+                time.sleep(0.005)
+        finally:
+            scheduler.stop()
+        self.assertEqual(controller.writes, 2)
+        self.assertEqual(self.read_brightness(path), 100)
+
+
+if __name__ == '__main__':
+    unittest.main()
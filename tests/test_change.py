@@ -0,0 +1,72 @@
+import math
+import unittest
+
+from macals import ChangeDetector
+
+
+def kinds(events):
+    return [event.kind for event in events]
+
+
+class ChangeDetectorTest(unittest.TestCase):
+    def test_steps(self):
+        detector = ChangeDetector(threshold=50, delta=1)
+        values = [100.0] * 50 + [200.0] * 50 + [20.0] * 50
+        events = detector.extend(list(range(len(values))), values)
+        self.assertEqual(kinds(events), ['step_up', 'step_down'])
+        up, down = events
+        self.assertTrue(50 <= up.timestamp_ns < 55)
+        self.assertEqual(up.value, 200.0)
+        self.assertTrue(100 <= down.timestamp_ns < 105)
+        self.assertEqual(down.value, 20.0)
+
+    def test_noise_below_threshold(self):
+        detector = ChangeDetector(threshold=50, delta=2)
+        values = [100.0 + (1.0 if i % 2 else -1.0) for i in range(1000)]
+        self.assertEqual(detector.extend(list(range(1000)), values), [])
+
+    def test_stuck_reports_once_and_rearms(self):
+        detector = ChangeDetector(threshold=1e9, stuck_samples=5)
+        values = [7.0] * 10 + [8.0] + [9.0] * 5
+        events = detector.extend([i * 10 for i in range(len(values))], values)
+        self.assertEqual(kinds(events), ['stuck', 'stuck'])
+        self.assertEqual(events[0].timestamp_ns, 40)
+        self.assertEqual(events[0].duration_ns, 40)
+        self.assertEqual(events[1].timestamp_ns, 150)
+
+    def test_gap_and_nan_dropouts(self):
+        detector = ChangeDetector(threshold=1e9, max_gap_ns=100)
+        events = detector.extend([0, 50, 500, 550, 600, 650], [1.0, 2.0, 3.0, math.nan, math.nan, 4.0])
+        self.assertEqual(kinds(events), ['dropout', 'dropout'])
+        self.assertEqual((events[0].timestamp_ns, events[0].duration_ns), (50, 450))
+        self.assertEqual(events[1].timestamp_ns, 550)
+        self.assertTrue(math.isnan(events[1].value))
+
+    def test_saturation(self):
+        detector = ChangeDetector(threshold=1e9, saturation=1000)
+        events = detector.extend([0, 1, 2, 3, 4], [10.0, 1000.0, 2000.0, 10.0, 1500.0])
+        self.assertEqual(kinds(events), ['saturation', 'saturation'])
+        self.assertEqual([e.timestamp_ns for e in events], [1, 4])
+
+    def test_push_matches_extend(self):
+        values = [100.0] * 20 + [300.0] * 20 + [math.nan] + [5.0] * 20
+        timestamps = list(range(len(values)))
+        pushed = ChangeDetector(threshold=40, stuck_samples=15)
+        events = [e for t, v in zip(timestamps, values) for e in pushed.push(t, v)]
+        expected = ChangeDetector(threshold=40, stuck_samples=15).extend(timestamps, values)
+        self.assertEqual(repr(events), repr(expected))
+
+    def test_rejects_bad_arguments(self):
+        with self.assertRaises(ValueError):
+            ChangeDetector(threshold=0)
+
+    def test_uninitialized(self):
+        detector = ChangeDetector.__new__(ChangeDetector)
+        with self.assertRaises(RuntimeError):
+            detector.push(0, 1.0)
+        with self.assertRaises(RuntimeError):
+            detector.extend([0], [1.0])
+
+
+if __name__ == '__main__':
+    unittest.main()
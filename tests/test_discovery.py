@@ -0,0 +1,37 @@
+import unittest
+
+from macals import find_sensor
+from macals import list_sensors
+
+try:
+    SENSOR = find_sensor()
+except RuntimeError:
+    SENSOR = None
+
+
+def identities(sensors):
+    return [(sensor.registry_id, sensor.name) for sensor in sensors]
+
+
+@unittest.skipUnless(SENSOR, 'needs an ambient light sensor')
+class DiscoveryTest(unittest.TestCase):
+    def test_order_is_stable_across_runs(self):
+        first = identities(list_sensors())
+        for _ in range(3):
+            self.assertEqual(identities(list_sensors()), first)
+
+    def test_interleaved_iterators_agree(self):
+        a, b = list_sensors(), list_sensors()
+        seen_a, seen_b = [], []
+        for sensor in a:
+            seen_a.append(sensor)
+            seen_b.extend(sensor for _, sensor in zip(range(2), b))
+        seen_b.extend(b)
+        self.assertEqual(identities(seen_a), identities(seen_b))
+
+    def test_starts_with_find_sensor(self):
+        self.assertEqual(identities(list_sensors())[0], identities([find_sensor()])[0])
+
+
+if __name__ == '__main__':
+    unittest.main()
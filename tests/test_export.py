@@ -0,0 +1,74 @@
+import unittest
+
+from macals import resample
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+try:
+    import pyarrow as pa
+except ImportError:
+    pa = None
+
+
+def make_batch():
+    return resample([0, 400], [1.0, 5.0], interval_ns=100)
+
+
+class ExportTest(unittest.TestCase):
+    def test_buffer_is_read_only(self):
+        batch = make_batch()
+        view = memoryview(batch.values)
+        self.assertTrue(view.readonly)
+        self.assertEqual(view.format, 'd')
+        self.assertEqual(view.tolist(), [1.0, 2.0, 3.0, 4.0, 5.0])
+        self.assertEqual(memoryview(batch.timestamps).tolist(), [0, 100, 200, 300, 400])
+
+    def test_dlpack_needs_versioned_consumer(self):
+        column = make_batch().values
+        with self.assertRaises(BufferError):
+            column.__dlpack__()
+        with self.assertRaises(BufferError):
+            column.__dlpack__(max_version=(0, 8))
+        self.assertIn('dltensor_versioned', repr(column.__dlpack__(max_version=(1, 0))))
+        self.assertEqual(column.__dlpack_device__(), (1, 0))
+
+    def test_arrow_requested_schema(self):
+        batch = make_batch()
+        schema, _ = batch.__arrow_c_array__()
+        batch.__arrow_c_array__(requested_schema=schema)
+        value_schema, _ = batch.values.__arrow_c_array__()
+        batch.values.__arrow_c_array__(requested_schema=value_schema)
+        with self.assertRaises(ValueError):
+            batch.timestamps.__arrow_c_array__(requested_schema=value_schema)
+        with self.assertRaises(ValueError):
+            batch.__arrow_c_array__(requested_schema=value_schema)
+
+    @unittest.skipUnless(np, 'needs numpy')
+    def test_numpy(self):
+        batch = make_batch()
+        values = np.from_dlpack(batch.values)
+        self.assertEqual(values.tolist(), [1.0, 2.0, 3.0, 4.0, 5.0])
+        self.assertFalse(values.flags.writeable)
+        self.assertEqual(np.from_dlpack(batch.timestamps).dtype, np.int64)
+
+    @unittest.skipUnless(pa, 'needs pyarrow')
+    def test_pyarrow(self):
+        batch = make_batch()
+        record_batch = pa.record_batch(batch)
+        self.assertEqual(record_batch.schema.names, ['timestamp_ns', 'lux'])
+        self.assertEqual(record_batch.column('lux').to_pylist(), [1.0, 2.0, 3.0, 4.0, 5.0])
+
+        array = pa.array(batch, type=pa.struct([('timestamp_ns', pa.timestamp('ns')), ('lux', pa.float64())]))
+        self.assertEqual(array.type.field('timestamp_ns').type, pa.timestamp('ns'))
+        self.assertEqual(pa.array(batch.timestamps, type=pa.duration('ns')).type, pa.duration('ns'))
+        with self.assertRaises(ValueError):
+            pa.array(batch.values, type=pa.float32())
+        with self.assertRaises(ValueError):
+            pa.array(batch, type=pa.struct([('t', pa.int64()), ('lux', pa.float64())]))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,99 @@
+import math
+import unittest
+
+from macals import FlickerAnalyzer
+from macals import Pipeline
+
+RATE = 2000.0
+
+
+def sine(frequency, mean, amplitude, count, start=0):
+    timestamps = [int((start + i) * 1e9 / RATE) for i in range(count)]
+    values = [mean + amplitude * math.sin(2 * math.pi * frequency * (start + i) / RATE) for i in range(count)]
+    return timestamps, values
+
+
+class FlickerAnalyzerTest(unittest.TestCase):
+    def test_sine(self):
+        analyzer = FlickerAnalyzer(sample_rate_hz=RATE, window=400)
+        windows = analyzer.extend(*sine(100.0, 100.0, 50.0, 800))
+        self.assertEqual(len(windows), 2)
+        for window in windows:
+            self.assertLess(abs(window.frequency_hz - 100.0), analyzer.resolution_hz / 2)
+            self.assertAlmostEqual(window.percent, 50.0, delta=0.5)
+            self.assertAlmostEqual(window.index, 50.0 / math.pi / 100.0, delta=0.005)
+            self.assertAlmostEqual(window.mean, 100.0, delta=0.5)
+
+    def test_dominant_frequency_with_offset_and_harmonic(self):
+        timestamps, values = sine(120.0, 300.0, 40.0, 1024)
+        values = [v + 10.0 * math.sin(2 * math.pi * 360.0 * i / RATE) for i, v in enumerate(values)]
+        analyzer = FlickerAnalyzer(sample_rate_hz=RATE, window=1024)
+        (window,) = analyzer.extend(timestamps, values)
+        self.assertLess(abs(window.frequency_hz - 120.0), analyzer.resolution_hz / 2)
+
+    def test_band_limits(self):
+        timestamps, values = sine(120.0, 300.0, 40.0, 1024)
+        values = [v + 10.0 * math.sin(2 * math.pi * 360.0 * i / RATE) for i, v in enumerate(values)]
+        analyzer = FlickerAnalyzer(sample_rate_hz=RATE, window=1024, min_hz=200)
+        (window,) = analyzer.extend(timestamps, values)
+        self.assertLess(abs(window.frequency_hz - 360.0), analyzer.resolution_hz / 2)
+
+    def test_flat(self):
+        analyzer = FlickerAnalyzer(sample_rate_hz=RATE, window=64)
+        (window,) = analyzer.extend(list(range(64)), [42.0] * 64)
+        self.assertEqual(window.frequency_hz, 0.0)
+        self.assertEqual(window.percent, 0.0)
+        self.assertEqual(window.index, 0.0)
+        self.assertEqual(window.timestamp_ns, 63)
+
+    def test_push_matches_extend(self):
+        timestamps, values = sine(50.0, 80.0, 20.0, 300)
+        pushed = FlickerAnalyzer(sample_rate_hz=RATE, window=128)
+        results = [w for w in (pushed.push(t, v) for t, v in zip(timestamps, values)) if w is not None]
+        self.assertEqual(results, FlickerAnalyzer(sample_rate_hz=RATE, window=128).extend(timestamps, values))
+
+    def test_rejects_bad_arguments(self):
+        with self.assertRaises(ValueError):
+            FlickerAnalyzer(sample_rate_hz=0)
+        with self.assertRaises(ValueError):
+            FlickerAnalyzer(sample_rate_hz=RATE, window=4)
+        with self.assertRaises(ValueError):
+            FlickerAnalyzer(sample_rate_hz=RATE, window=64, min_hz=910, max_hz=930)
+
+    def test_uninitialized(self):
+        analyzer = FlickerAnalyzer.__new__(FlickerAnalyzer)
+        with self.assertRaises(RuntimeError):
+            analyzer.push(0, 1.0)
+        analyzer = FlickerAnalyzer(sample_rate_hz=RATE, window=64)
+        with self.assertRaises(ValueError):
+            analyzer.__init__(sample_rate_hz=-1)
+        with self.assertRaises(RuntimeError):
+            analyzer.extend([0], [1.0])
+
+
+class PipelineFlickerTest(unittest.TestCase):
+    def test_matches_analyzer(self):
+        timestamps, values = sine(100.0, 100.0, 50.0, 1200)
+        pipeline = Pipeline({'calibrate': {'gain': 2.0}, 'flicker': {'sample_rate_hz': RATE, 'window': 400}, 'filter': {'type': 'median'}})
+        pipeline.extend(timestamps, values)
+        expected = FlickerAnalyzer(sample_rate_hz=RATE, window=400).extend(timestamps, [2.0 * v for v in values])
+        self.assertEqual(pipeline.flicker(), expected)
+        self.assertEqual(pipeline.flicker(), [])
+
+    def test_keeps_newest_windows(self):
+        pipeline = Pipeline({'flicker': {'sample_rate_hz': RATE, 'window': 8}})
+        pipeline.extend(list(range(8 * 70)), [1.0] * (8 * 70))
+        windows = pipeline.flicker()
+        self.assertEqual(len(windows), 64)
+        self.assertEqual(windows[-1].timestamp_ns, 8 * 70 - 1)
+        self.assertEqual(windows[0].timestamp_ns, 8 * 7 - 1)
+
+    def test_requires_stage(self):
+        with self.assertRaises(RuntimeError):
+            Pipeline({}).flicker()
+        with self.assertRaises(ValueError):
+            Pipeline({'flicker': {'sample_rate_hz': 0}})
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,25 @@
+import unittest
+
+from macals import find_sensor
+from macals import read_once
+
+try:
+    SENSOR = find_sensor()
+except RuntimeError:
+    SENSOR = None
+
+
+@unittest.skipUnless(SENSOR, 'needs an ambient light sensor')
+class ReadOnceTest(unittest.TestCase):
+    def test_reads_by_name_and_registry_id(self):
+        self.assertIsInstance(read_once(SENSOR.name), float)
+        self.assertIsInstance(read_once(SENSOR.registry_id), float)
+        self.assertIsInstance(read_once(), float)
+
+    def test_rejects_services_without_lux(self):
+        with self.assertRaises(RuntimeError):
+            read_once('IOResources')
+
+
+if __name__ == '__main__':
+    unittest.main()
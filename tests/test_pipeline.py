@@ -0,0 +1,57 @@
+import unittest
+
+from macals import Pipeline
+
+
+class DeadbandTest(unittest.TestCase):
+    def pipeline(self, **deadband):
+        pipeline = Pipeline({'deadband': deadband})
+        self.assertEqual(pipeline.push(0, 1000.0), 1000.0)
+        return pipeline
+
+    def test_either_limit_passes(self):
+        pipeline = self.pipeline(absolute=5.0, relative=0.02)
+        self.assertIsNone(pipeline.push(1, 1004.9))
+        self.assertEqual(pipeline.push(2, 1005.1), 1005.1)
+
+        pipeline = self.pipeline(absolute=50.0, relative=0.02)
+        self.assertIsNone(pipeline.push(1, 1019.9))
+        self.assertEqual(pipeline.push(2, 1020.1), 1020.1)
+
+    def test_single_limit(self):
+        pipeline = self.pipeline(relative=0.02)
+        self.assertIsNone(pipeline.push(1, 980.1))
+        self.assertEqual(pipeline.push(2, 979.9), 979.9)
+
+        pipeline = self.pipeline(absolute=5.0)
+        self.assertIsNone(pipeline.push(1, 995.1))
+        self.assertEqual(pipeline.push(2, 994.9), 994.9)
+
+    def test_heartbeat(self):
+        pipeline = self.pipeline(absolute=5.0, max_interval_ns=100)
+        self.assertIsNone(pipeline.push(99, 1000.0))
+        self.assertEqual(pipeline.push(100, 1000.0), 1000.0)
+        self.assertEqual(pipeline.emitted, 2)
+        self.assertEqual(pipeline.samples, 3)
+
+
+class RingOrderTest(unittest.TestCase):
+    def test_rejects_backwards_timestamps(self):
+        for fmt in ('float64', 'float16'):
+            pipeline = Pipeline({'sinks': [{'type': 'ring', 'format': fmt}]})
+            pipeline.extend([10, 20, 20], [1.0, 2.0, 3.0])
+            with self.assertRaises(ValueError):
+                pipeline.push(19, 4.0)
+            with self.assertRaises(ValueError):
+                pipeline.extend([30, 25], [5.0, 6.0])
+            self.assertEqual(list(pipeline.drain().timestamps), [10, 20, 20, 30])
+            self.assertEqual(pipeline.samples, 4)
+
+    def test_without_ring(self):
+        pipeline = Pipeline({'stats': True})
+        pipeline.push(10, 1.0)
+        self.assertEqual(pipeline.push(5, 2.0), 2.0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,46 @@
+import os
+import unittest
+
+from macals import SensorDescriptor
+from macals import SensorPool
+from macals import find_sensor
+
+try:
+    SENSOR = find_sensor()
+except RuntimeError:
+    SENSOR = None
+
+
+@unittest.skipUnless(SENSOR, 'needs an ambient light sensor')
+class SensorPoolTest(unittest.TestCase):
+    def test_does_not_cache_caller_sensors(self):
+        (descriptor,) = SensorPool([SENSOR])
+        self.assertIsNot(descriptor.open(), SENSOR)
+        self.assertIs(descriptor.open(), descriptor.open())
+
+    def test_name_fallback_shares_resolved_sensor(self):
+        (descriptor,) = SensorPool([SENSOR.name])
+        stale = SensorDescriptor(descriptor.name, 0xdeadbeef)
+        self.assertIs(stale.open(), descriptor.open())
+
+    @unittest.skipUnless(hasattr(os, 'fork'), 'needs fork')
+    def test_reopens_cached_sensors_after_fork(self):
+        (descriptor,) = SensorPool([SENSOR.name])
+        sensor = descriptor.open()
+        pid = os.fork()
+        if pid == 0:
+            status = 1
+            try:
+                child = descriptor.open()
+                SENSOR.get_current_lux()
+                child.get_current_lux()
+                status = 0 if child is sensor else 2
+            finally:
+                os._exit(status)
+        _, status = os.waitpid(pid, 0)
+        self.assertEqual(os.waitstatus_to_exitcode(status), 0)
+        sensor.get_current_lux()
+
+
+if __name__ == '__main__':
+    unittest.main()
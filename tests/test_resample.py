@@ -0,0 +1,69 @@
+import math
+import unittest
+
+from macals import Resampler, resample
+
+
+class ResampleTest(unittest.TestCase):
+    def test_linear(self):
+        batch = resample([0, 1000], [0.0, 10.0], interval_ns=250)
+        self.assertEqual(list(batch.timestamps), [0, 250, 500, 750, 1000])
+        self.assertEqual(list(batch.values), [0.0, 2.5, 5.0, 7.5, 10.0])
+
+    def test_hold(self):
+        batch = resample([0, 500, 1000], [1.0, 2.0, 3.0], interval_ns=250, method='hold')
+        self.assertEqual(list(batch.values), [1.0, 1.0, 2.0, 2.0, 3.0])
+
+    def test_cubic_reproduces_a_line(self):
+        timestamps = [0, 300, 700, 1000, 1600]
+        batch = resample(timestamps, [2.0 * t + 1.0 for t in timestamps], interval_ns=100, method='cubic')
+        self.assertEqual(len(batch), 17)
+        for t, v in zip(batch.timestamps, batch.values):
+            self.assertAlmostEqual(v, 2.0 * t + 1.0)
+
+    def test_grid_is_aligned(self):
+        batch = resample([130, 520], [0.0, 1.0], interval_ns=100)
+        self.assertEqual(list(batch.timestamps), [200, 300, 400, 500])
+
+    def test_gap_is_nan(self):
+        batch = resample([0, 100, 1000], [1.0, 1.0, 1.0], interval_ns=100, max_gap_ns=500)
+        values = list(batch.values)
+        self.assertEqual(len(values), 11)
+        self.assertEqual(values[0], 1.0)
+        self.assertTrue(all(math.isnan(v) for v in values[1:-1]))
+        self.assertEqual(values[-1], 1.0)
+
+    def test_rejects_backwards_timestamps(self):
+        with self.assertRaises(ValueError):
+            resample([0, 100, 50], [1.0, 2.0, 3.0], interval_ns=10)
+
+    def test_rejects_bad_arguments(self):
+        with self.assertRaises(ValueError):
+            resample([0], [1.0], interval_ns=0)
+        with self.assertRaises(ValueError):
+            resample([0], [1.0], interval_ns=10, method='spline')
+        with self.assertRaises(ValueError):
+            resample([0, 1], [1.0], interval_ns=10)
+
+    def test_streaming_matches_batch(self):
+        timestamps = [0, 130, 270, 420, 560, 910, 1000, 1330]
+        values = [3.0, 5.0, 4.0, 8.0, 1.0, 2.0, 6.0, 7.0]
+        for method in ('linear', 'hold', 'cubic'):
+            expected = resample(timestamps, values, interval_ns=50, method=method)
+            resampler = Resampler(50, method=method)
+            out = []
+            for t, v in zip(timestamps, values):
+                out.extend(resampler.push(t, v))
+            out.extend(resampler.flush())
+            self.assertEqual(out, list(expected), method)
+
+    def test_uninitialized(self):
+        resampler = Resampler.__new__(Resampler)
+        with self.assertRaises(RuntimeError):
+            resampler.push(0, 1.0)
+        with self.assertRaises(RuntimeError):
+            resampler.flush()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,111 @@
+import random
+import struct
+import unittest
+
+from macals import Pipeline
+
+BLOCK = 256
+
+
+def ring(fmt, capacity=4096):
+    return Pipeline({'sinks': [{'type': 'ring', 'capacity': capacity, 'format': fmt}]})
+
+
+def readings(count, seed=1):
+    rng = random.Random(seed)
+    timestamps, values, t = [], [], 1_000_000_000
+    for _ in range(count):
+        t += rng.randrange(1, 20_000_000)
+        timestamps.append(t)
+        values.append(rng.choice([0.0, rng.uniform(0, 5), rng.uniform(0, 500), rng.uniform(0, 80000)]))
+    return timestamps, values
+
+
+def as_float32(value):
+    return struct.unpack('f', struct.pack('f', value))[0]
+
+
+class CompactRingTest(unittest.TestCase):
+    def roundtrip(self, fmt, timestamps, values):
+        pipeline = ring(fmt)
+        pipeline.extend(timestamps, values)
+        batch = pipeline.drain()
+        return list(batch.timestamps), list(batch.values)
+
+    def test_float32_exact(self):
+        timestamps, values = readings(1000)
+        values = [as_float32(v) for v in values]
+        self.assertEqual(self.roundtrip('float32', timestamps, values), (timestamps, values))
+
+    def test_float16_relative_error(self):
+        timestamps, values = readings(1000)
+        out_timestamps, out = self.roundtrip('float16', timestamps, values)
+        self.assertEqual(out_timestamps, timestamps)
+        for value, decoded in zip(values, out):
+            if value > 65504:
+                self.assertEqual(decoded, 65504.0)
+            elif value >= 2 ** -14:
+                self.assertLess(abs(decoded - value), value * 2 ** -11)
+
+    def test_uint16_absolute_error(self):
+        timestamps, values = readings(1000)
+        out_timestamps, out = self.roundtrip('uint16', timestamps, values)
+        self.assertEqual(out_timestamps, timestamps)
+        for start in range(0, len(values), BLOCK):
+            block = values[start:start + BLOCK]
+            bound = max(block) / 32767
+            for value, decoded in zip(block, out[start:start + BLOCK]):
+                self.assertLess(abs(decoded - value), bound)
+
+    def test_uint16_rising_block(self):
+        values = [1.0 * 1.05 ** i for i in range(BLOCK)]
+        timestamps = list(range(BLOCK))
+        _, out = self.roundtrip('uint16', timestamps, values)
+        for value, decoded in zip(values, out):
+            self.assertLess(abs(decoded - value), max(values) / 32767)
+
+    def test_uint16_negative_readings(self):
+        rng = random.Random(2)
+        values = [rng.uniform(-40, 10) for _ in range(1000)]
+        timestamps = list(range(len(values)))
+        _, out = self.roundtrip('uint16', timestamps, values)
+        for start in range(0, len(values), BLOCK):
+            block = values[start:start + BLOCK]
+            bound = (max(block) - min(block)) / 16383
+            for value, decoded in zip(block, out[start:start + BLOCK]):
+                self.assertLess(abs(decoded - value), bound)
+
+    def test_uint16_constant_negative_block(self):
+        _, out = self.roundtrip('uint16', list(range(BLOCK)), [-2.0] * BLOCK)
+        self.assertEqual(out, [-2.0] * BLOCK)
+
+    def test_uint16_nan(self):
+        nan, inf = float('nan'), float('inf')
+        values = [nan, 3.0, nan, -1.0, inf, 250.0, nan]
+        _, out = self.roundtrip('uint16', list(range(len(values))), values)
+        for value, decoded in zip(values, out):
+            if value != value or value == inf:
+                self.assertNotEqual(decoded, decoded)
+            else:
+                self.assertLess(abs(decoded - value), 251 / 16383)
+
+    def test_long_block_timestamps(self):
+        timestamps = [i * 3_000_000_000 + (i % 7) for i in range(BLOCK)]
+        out_timestamps, _ = self.roundtrip('float16', timestamps, [1.0] * BLOCK)
+        span = timestamps[-1] - timestamps[0]
+        for timestamp, decoded in zip(timestamps, out_timestamps):
+            self.assertLessEqual(decoded, timestamp)
+            self.assertLess(timestamp - decoded, span / 2_000_000_000 + 1)
+        self.assertEqual(out_timestamps, sorted(out_timestamps))
+
+    def test_history_after_wrap(self):
+        timestamps, values = readings(3000)
+        pipeline = ring('uint16', capacity=1000)
+        pipeline.extend(timestamps, values)
+        since, until = timestamps[2500], timestamps[2700]
+        self.assertEqual(list(pipeline.history(since_ns=since, until_ns=until).timestamps), timestamps[2500:2700])
+        self.assertEqual(len(pipeline.history(since_ns=0, until_ns=until)), 700)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,118 @@
+import math
+import random
+import unittest
+
+from macals import RuleSet
+
+
+class Reference:
+    """Visits every rule on every reading."""
+
+    def __init__(self):
+        self.rules = []
+
+    def add(self, threshold, hysteresis=0.0, dwell_ns=0, below=False, key=None):
+        self.rules.append({'key': key, 'threshold': threshold, 'hysteresis': hysteresis, 'dwell': dwell_ns, 'below': below, 'state': 'armed', 'since': 0})
+
+    def push(self, timestamp, lux):
+        events = []
+        if math.isnan(lux):
+            return events
+        for rule in self.rules:
+            x = -lux if rule['below'] else lux
+            level = -rule['threshold'] if rule['below'] else rule['threshold']
+            if rule['state'] == 'armed' and x >= level:
+                rule['state'] = 'pending'
+                rule['since'] = timestamp
+            elif rule['state'] == 'pending' and x < level:
+                rule['state'] = 'armed'
+            elif rule['state'] == 'fired' and x < level - rule['hysteresis']:
+                rule['state'] = 'armed'
+                events.append((timestamp, rule['key'], lux, False))
+        for rule in self.rules:
+            if rule['state'] == 'pending' and timestamp - rule['since'] >= rule['dwell']:
+                rule['state'] = 'fired'
+                events.append((timestamp, rule['key'], lux, True))
+        return events
+
+
+def plain(events):
+    return sorted((e.timestamp_ns, e.rule, e.value, e.active) for e in events)
+
+
+class RuleSetTest(unittest.TestCase):
+    def test_hysteresis(self):
+        rules = RuleSet()
+        rules.add(100, hysteresis=10, key='bright')
+        events = rules.evaluate([0, 1, 2, 3, 4], [50.0, 100.0, 95.0, 89.0, 120.0])
+        self.assertEqual(plain(events), [(1, 'bright', 100.0, True), (3, 'bright', 89.0, False), (4, 'bright', 120.0, True)])
+
+    def test_below(self):
+        rules = RuleSet()
+        rule = rules.add(10, hysteresis=5, below=True)
+        events = rules.evaluate([0, 1, 2, 3], [20.0, 10.0, 14.0, 16.0])
+        self.assertEqual(plain(events), [(1, rule, 10.0, True), (3, rule, 16.0, False)])
+
+    def test_dwell(self):
+        rules = RuleSet()
+        rules.add(100, dwell_ns=100, key='k')
+        self.assertEqual(rules.evaluate([0, 50, 60, 100, 199], [150.0, 150.0, 50.0, 150.0, 150.0]), [])
+        self.assertEqual(rules.active, [])
+        self.assertEqual(plain(rules.push(200, 150.0)), [(200, 'k', 150.0, True)])
+        self.assertEqual(rules.active, ['k'])
+
+    def test_remove(self):
+        rules = RuleSet()
+        a = rules.add(10)
+        b = rules.add(20)
+        rules.remove(a)
+        self.assertEqual(len(rules), 1)
+        self.assertEqual(plain(rules.push(0, 30.0)), [(0, b, 30.0, True)])
+        with self.assertRaises(KeyError):
+            rules.remove(a)
+
+    def test_nan_is_skipped(self):
+        rules = RuleSet()
+        rules.add(100, hysteresis=10, dwell_ns=100, key='k')
+        events = rules.evaluate([0, 50, 100, 150], [150.0, math.nan, math.nan, 150.0])
+        self.assertEqual(plain(events), [(150, 'k', 150.0, True)])
+        self.assertEqual(rules.push(200, math.nan), [])
+        self.assertEqual(rules.active, ['k'])
+        self.assertEqual(plain(rules.push(300, 50.0)), [(300, 'k', 50.0, False)])
+
+    def test_matches_reference(self):
+        rng = random.Random(1234)
+        rules = RuleSet()
+        reference = Reference()
+        for i in range(300):
+            spec = dict(threshold=rng.uniform(0, 1000), hysteresis=rng.choice([0.0, rng.uniform(0, 50)]), dwell_ns=rng.choice([0, rng.randrange(1, 20)]), below=rng.random() < 0.5, key=i)
+            rules.add(**spec)
+            reference.add(**spec)
+
+        lux = 500.0
+        timestamps, values = [], []
+        for t in range(5000):
+            lux = min(max(lux + rng.gauss(0, 60), 0.0), 1000.0)
+            if t % 97 == 0:
+                lux = rng.choice([0.0, 1000.0, round(lux)])
+            timestamps.append(t)
+            values.append(math.nan if t % 211 == 0 else lux)
+
+        expected = []
+        for t, v in zip(timestamps, values):
+            expected.extend(reference.push(t, v))
+        half = len(timestamps) // 2
+        events = rules.evaluate(timestamps[:half], values[:half])
+        events += [e for t, v in zip(timestamps[half:], values[half:]) for e in rules.push(t, v)]
+        self.assertGreater(len(expected), 100)
+        self.assertEqual(plain(events), sorted(expected))
+
+    def test_uninitialized(self):
+        rules = RuleSet.__new__(RuleSet)
+        self.assertEqual(len(rules), 0)
+        rule = rules.add(1)
+        self.assertEqual(plain(rules.push(0, 2.0)), [(0, rule, 2.0, True)])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,126 @@
+import time
+import unittest
+
+from macals import Pipeline
+from macals import ReplaySource
+from macals import Scheduler
+
+
+def wait_for(predicate, timeout=5.0):
+    deadline = time.monotonic() + timeout
+    while not predicate():
+        if time.monotonic() > deadline:
+            return False
+        time.sleep(0.005)
+    return True
+
+
+def ring_pipeline():
+    return Pipeline({'sinks': [{'type': 'ring', 'capacity': 4096}]})
+
+
+class ReplaySourceTest(unittest.TestCase):
+    def test_plays_values_in_order(self):
+        source = ReplaySource([1.0, 2.0, 3.0], loop=False)
+        pipeline = ring_pipeline()
+        scheduler = Scheduler(workers=1, tick_ns=100_000)
+        scheduler.add(source, 1_000_000, pipeline=pipeline)
+        scheduler.start()
+        try:
+            self.assertTrue(wait_for(lambda: scheduler.errors > 0))
+        finally:
+            scheduler.stop()
+        batch = pipeline.drain()
+        self.assertEqual(list(batch.values), [1.0, 2.0, 3.0])
+        self.assertEqual(source.position, 3)
+        self.assertEqual(scheduler.reads, 3)
+        timestamps = list(batch.timestamps)
+        self.assertEqual(timestamps, sorted(timestamps))
+
+    def test_loops(self):
+        source = ReplaySource([5.0, 6.0])
+        pipeline = ring_pipeline()
+        scheduler = Scheduler(workers=1, tick_ns=100_000)
+        scheduler.add(source, 1_000_000, pipeline=pipeline)
+        scheduler.start()
+        try:
+            self.assertTrue(wait_for(lambda: pipeline.samples >= 5))
+        finally:
+            scheduler.stop()
+        values = list(pipeline.drain().values)
+        self.assertEqual(values, [5.0, 6.0] * (len(values) // 2) + [5.0] * (len(values) % 2))
+        self.assertEqual(scheduler.errors, 0)
+
+    def test_rewind_and_reinit(self):
+        source = ReplaySource([1.0, 2.0])
+        self.assertEqual(len(source), 2)
+        source.__init__([3.0, 4.0, 5.0])
+        self.assertEqual(len(source), 3)
+        source.rewind()
+        self.assertEqual(source.position, 0)
+        with self.assertRaises(ValueError):
+            ReplaySource([])
+
+    def test_add_checks_arguments(self):
+        scheduler = Scheduler()
+        with self.assertRaises(ValueError):
+            scheduler.add(ReplaySource([1.0]), 1_000_000)
+        with self.assertRaises(TypeError):
+            scheduler.add(object(), 1_000_000, pipeline=ring_pipeline())
+        source = ReplaySource([1.0])
+        scheduler.add(source, 1_000_000, pipeline=ring_pipeline())
+        self.assertEqual(len(scheduler), 1)
+        scheduler.remove(source)
+        self.assertEqual(len(scheduler), 0)
+        with self.assertRaises(ValueError):
+            scheduler.remove(source)
+
+
+class SchedulerTest(unittest.TestCase):
+    def test_many_sources(self):
+        scheduler = Scheduler(workers=4, tick_ns=100_000)
+        pipelines = [ring_pipeline() for _ in range(500)]
+        for i, pipeline in enumerate(pipelines):
+            scheduler.add(ReplaySource([float(i)]), 1_000_000 + i * 10_000, pipeline=pipeline)
+        scheduler.start()
+        try:
+            self.assertTrue(wait_for(lambda: all(p.samples >= 3 for p in pipelines)))
+        finally:
+            scheduler.stop()
+        for i, pipeline in enumerate(pipelines):
+            self.assertEqual(set(pipeline.drain().values), {float(i)})
+
+    def test_uninitialized(self):
+        scheduler = Scheduler.__new__(Scheduler)
+        source = ReplaySource([1.0])
+        with self.assertRaises(RuntimeError):
+            scheduler.add(source, 1, pipeline=ring_pipeline())
+        with self.assertRaises(RuntimeError):
+            scheduler.remove(source)
+        with self.assertRaises(RuntimeError):
+            scheduler.start()
+        scheduler.stop()
+        self.assertEqual((len(scheduler), scheduler.reads, scheduler.errors, scheduler.running), (0, 0, 0, False))
+
+    def test_restart_after_long_stop(self):
+        pipeline = ring_pipeline()
+        scheduler = Scheduler(workers=1, tick_ns=10_000)
+        scheduler.add(ReplaySource([1.0]), 3_600_000_000_000, pipeline=pipeline)
+        scheduler.add(ReplaySource([2.0]), 1_000_000, pipeline=pipeline)
+        scheduler.start()
+        self.assertTrue(wait_for(lambda: pipeline.samples >= 2))
+        scheduler.stop()
+        time.sleep(0.5)
+        samples = pipeline.samples
+        started = time.monotonic()
+        scheduler.start()
+        try:
+            self.assertTrue(wait_for(lambda: pipeline.samples > samples + 5, timeout=1.0))
+        finally:
+            scheduler.stop()
+        self.assertLess(time.monotonic() - started, 1.0)
+        self.assertEqual(list(pipeline.drain().values).count(1.0), 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,52 @@
+import unittest
+
+from macals import ReplaySource
+from macals import SensorGroup
+from macals import find_sensor
+
+try:
+    SENSOR = find_sensor()
+except RuntimeError:
+    SENSOR = None
+
+
+class SensorGroupTest(unittest.TestCase):
+    def test_read_in_group_order(self):
+        group = SensorGroup([ReplaySource([1.0, 2.0]), ReplaySource([10.0]), ReplaySource([100.0, 200.0, 300.0])])
+        self.assertEqual(group.read(), (1.0, 10.0, 100.0))
+        self.assertEqual(group.read(), (2.0, 10.0, 200.0))
+
+    def test_snapshot_in_group_order(self):
+        values = [float(i) for i in range(8)]
+        group = SensorGroup([ReplaySource([value]) for value in values])
+        self.assertEqual(len(group), 8)
+        snapshot = group.snapshot()
+        self.assertEqual(list(snapshot.values), values)
+        self.assertEqual(len(snapshot.timestamps), 8)
+
+    def test_exhausted_source_raises(self):
+        group = SensorGroup([ReplaySource([1.0]), ReplaySource([5.0], loop=False)])
+        self.assertEqual(group.read(), (1.0, 5.0))
+        with self.assertRaisesRegex(RuntimeError, 'index 1'):
+            group.read()
+        with self.assertRaisesRegex(RuntimeError, 'index 1'):
+            group.snapshot()
+
+    def test_rejects_other_members(self):
+        with self.assertRaises(TypeError):
+            SensorGroup([ReplaySource([1.0]), 1.0])
+
+    def test_uninitialized(self):
+        with self.assertRaises(RuntimeError):
+            SensorGroup.__new__(SensorGroup).read()
+
+    @unittest.skipUnless(SENSOR, 'needs an ambient light sensor')
+    def test_mixed_with_sensor(self):
+        group = SensorGroup([ReplaySource([7.0]), SENSOR])
+        value, lux = group.read()
+        self.assertEqual(value, 7.0)
+        self.assertIsInstance(lux, float)
+
+
+if __name__ == '__main__':
+    unittest.main()
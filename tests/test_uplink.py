@@ -0,0 +1,219 @@
+import os
+import socket
+import struct
+import tempfile
+import threading
+import time
+import unittest
+import zlib
+
+from macals import Uplink
+
+
+def wait_for(predicate, timeout=10.0):
+    deadline = time.monotonic() + timeout
+    while not predicate():
+        if time.monotonic() > deadline:
+            return False
+        time.sleep(0.01)
+    return True
+
+
+class Collector:
+    """Stand-in collector: decodes frames and acknowledges them, except that
+    the first `unacked` frames it receives are answered by hanging up."""
+
+    def __init__(self, path, unacked=0):
+        self.frames = []
+        self.unacked = unacked
+        self.server = socket.socket(socket.AF_UNIX)
+        self.server.bind(path)
+        self.server.listen(4)
+        self.thread = threading.Thread(target=self.run, daemon=True)
+        self.thread.start()
+
+    def close(self):
+        self.server.close()
+
+    def recv_exactly(self, conn, length):
+        data = b''
+        while len(data) < length:
+            chunk = conn.recv(length - len(data))
+            if not chunk:
+                raise EOFError
+            data += chunk
+        return data
+
+    def run(self):
+        while True:
+            try:
+                conn, _ = self.server.accept()
+            except OSError:
+                return
+            with conn:
+                try:
+                    self.serve(conn)
+                except EOFError:
+                    pass
+
+    def serve(self, conn):
+        while True:
+            header = self.recv_exactly(conn, 32)
+            magic, version, flags, seq, count, raw_length, length, crc = struct.unpack('<4sHHQIIII', header)
+            payload = self.recv_exactly(conn, length)
+            assert magic == b'MLUX' and version == 1 and zlib.crc32(payload) == crc
+            raw = zlib.decompress(payload)
+            assert len(raw) == raw_length == 16 * count
+            deltas = struct.unpack('<%dq' % count, raw[:8 * count])
+            values = struct.unpack('<%dd' % count, raw[8 * count:])
+            timestamps, t = [], 0
+            for delta in deltas:
+                t += delta
+                timestamps.append(t)
+            if self.unacked:
+                self.unacked -= 1
+                return
+            self.frames.append((seq, timestamps, list(values)))
+            conn.sendall(struct.pack('<Q', seq))
+
+    def readings(self):
+        return [r for _, timestamps, values in self.frames for r in zip(timestamps, values)]
+
+    def seqs(self):
+        return [frame[0] for frame in self.frames]
+
+
+def readings(count, start=0):
+    return [1_000_000_000 + i * 1_000_000 for i in range(start, start + count)], [float(i % 97) for i in range(start, start + count)]
+
+
+class UplinkTest(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.addCleanup(self.tmp.cleanup)
+        self.path = os.path.join(self.tmp.name, 'collector.sock')
+        self.address = 'unix://' + self.path
+        self.spool = os.path.join(self.tmp.name, 'spool')
+
+    def collector(self, **kwargs):
+        collector = Collector(self.path, **kwargs)
+        self.addCleanup(collector.close)
+        return collector
+
+    def uplink(self, **kwargs):
+        kwargs.setdefault('batch', 10)
+        kwargs.setdefault('max_delay_ns', 20_000_000)
+        uplink = Uplink(self.address, **kwargs)
+        self.addCleanup(uplink.close)
+        return uplink
+
+    def spool_files(self):
+        return sorted(name for name in os.listdir(self.spool) if name.endswith('.mlux'))
+
+    def test_delivers_in_order(self):
+        collector = self.collector()
+        uplink = self.uplink()
+        timestamps, values = readings(95)
+        uplink.extend(timestamps, values)
+        uplink.flush()
+        self.assertTrue(wait_for(lambda: uplink.sent == 95))
+        self.assertEqual(collector.readings(), list(zip(timestamps, values)))
+        self.assertEqual([len(frame[1]) for frame in collector.frames], [10] * 9 + [5])
+        seqs = collector.seqs()
+        self.assertEqual(seqs, list(range(seqs[0], seqs[0] + 10)))
+        self.assertTrue(uplink.connected)
+
+    def test_reconnects_and_replays_spool(self):
+        uplink = self.uplink(spool_dir=self.spool)
+        timestamps, values = readings(50)
+        uplink.extend(timestamps, values)
+        uplink.flush()
+        self.assertTrue(wait_for(lambda: uplink.spooled == 50))
+        self.assertEqual(len(self.spool_files()), 5)
+
+        collector = self.collector()
+        more_timestamps, more_values = readings(20, start=50)
+        uplink.extend(more_timestamps, more_values)
+        uplink.flush()
+        self.assertTrue(wait_for(lambda: uplink.sent == 70))
+        self.assertEqual(collector.readings(), list(zip(timestamps + more_timestamps, values + more_values)))
+        self.assertEqual(collector.seqs(), sorted(collector.seqs()))
+        self.assertEqual(self.spool_files(), [])
+        self.assertEqual(uplink.spooled, 0)
+
+    def test_resends_unacknowledged_frame(self):
+        collector = self.collector(unacked=1)
+        uplink = self.uplink(spool_dir=self.spool)
+        timestamps, values = readings(30)
+        uplink.extend(timestamps, values)
+        uplink.flush()
+        self.assertTrue(wait_for(lambda: uplink.sent == 30))
+        self.assertEqual(collector.readings(), list(zip(timestamps, values)))
+        self.assertEqual(uplink.dropped, 0)
+
+    def test_spool_cap_drops_oldest(self):
+        uplink = self.uplink(spool_dir=self.spool, spool_max_bytes=1000)
+        uplink.extend(*readings(200))
+        uplink.flush()
+        self.assertTrue(wait_for(lambda: uplink.spooled + uplink.dropped == 200))
+        self.assertGreater(uplink.dropped, 0)
+        size = sum(os.path.getsize(os.path.join(self.spool, name)) for name in self.spool_files())
+        self.assertLessEqual(size, 1000)
+
+        collector = self.collector()
+        uplink.close()
+        kept = collector.readings()
+        self.assertEqual(len(kept), 200 - uplink.dropped)
+        self.assertEqual(kept, list(zip(*readings(200)))[-len(kept):])
+
+    def test_replays_spool_after_restart(self):
+        first = self.uplink(spool_dir=self.spool)
+        timestamps, values = readings(40)
+        first.extend(timestamps, values)
+        first.close()
+        self.assertEqual(first.spooled, 40)
+
+        second = self.uplink(spool_dir=self.spool)
+        self.assertEqual(second.spooled, 40)
+        collector = self.collector()
+        more_timestamps, more_values = readings(5, start=40)
+        second.extend(more_timestamps, more_values)
+        second.flush()
+        self.assertTrue(wait_for(lambda: second.sent == 45))
+        self.assertEqual(collector.readings(), list(zip(timestamps + more_timestamps, values + more_values)))
+        self.assertEqual(collector.seqs(), sorted(set(collector.seqs())))
+
+    def test_sequence_survives_restart_with_empty_spool(self):
+        collector = self.collector()
+        for _ in range(3):
+            uplink = self.uplink(spool_dir=self.spool)
+            uplink.extend(*readings(20))
+            uplink.close()
+            self.assertEqual(uplink.sent, 20)
+        seqs = collector.seqs()
+        self.assertEqual(len(seqs), 6)
+        self.assertEqual(seqs, sorted(set(seqs)))
+        self.assertEqual(self.spool_files(), [])
+
+    def test_sequence_continues_from_saved_reservation(self):
+        collector = self.collector()
+        os.makedirs(self.spool)
+        with open(os.path.join(self.spool, 'seq'), 'w') as f:
+            f.write('%d\n' % 2 ** 62)
+        uplink = self.uplink(spool_dir=self.spool)
+        uplink.extend(*readings(10))
+        uplink.close()
+        self.assertEqual(collector.seqs(), [2 ** 62])
+        with open(os.path.join(self.spool, 'seq')) as f:
+            self.assertGreater(int(f.read()), 2 ** 62)
+
+    def test_spool_dir_is_locked(self):
+        uplink = self.uplink(spool_dir=self.spool)
+        with self.assertRaises(RuntimeError):
+            Uplink(self.address, spool_dir=self.spool)
+        uplink.close()
+        self.uplink(spool_dir=self.spool)
+
+
+if __name__ == '__main__':
+    unittest.main()